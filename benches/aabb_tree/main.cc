@@ -0,0 +1,99 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <CGAL/Bbox_3.h>
+#include <CGAL/Exact_predicates_exact_constructions_kernel.h>
+#include <kigumi/AABB_tree/AABB_tree.h>
+#include <kigumi/Triangle_soup.h>
+#include <kigumi/Triangle_soup_io.h>
+#include <kigumi/mesh_utility.h>
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using K = CGAL::Exact_predicates_exact_constructions_kernel;
+using Triangle_soup = kigumi::Triangle_soup<K>;
+using Leaf = Triangle_soup::Leaf;
+using kigumi::AABB_split_method;
+using kigumi::read_triangle_soup;
+
+namespace {
+
+// A box query that counts the box tests performed by the tree.
+struct Counting_query {
+  CGAL::Bbox_3 bbox;
+  std::size_t* num_box_tests;
+};
+
+bool do_intersect(const CGAL::Bbox_3& bbox, const Counting_query& query) {
+  ++*query.num_box_tests;
+  return CGAL::do_overlap(bbox, query.bbox);
+}
+
+void run(const Triangle_soup& a, const Triangle_soup& b, AABB_split_method split_method,
+         const std::string& name) {
+  Triangle_soup soup{a};
+  soup.set_aabb_split_method(split_method);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  const auto& tree = soup.aabb_tree();
+  auto end = std::chrono::high_resolution_clock::now();
+  auto build_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+  std::size_t num_box_tests{};
+  std::size_t num_leaves{};
+  std::vector<const Leaf*> leaves;
+
+  start = std::chrono::high_resolution_clock::now();
+  for (auto fi : b.faces()) {
+    leaves.clear();
+    Counting_query query{kigumi::internal::face_bbox(b, fi), &num_box_tests};
+    tree.get_intersecting_leaves(std::back_inserter(leaves), query);
+    num_leaves += leaves.size();
+  }
+  end = std::chrono::high_resolution_clock::now();
+  auto query_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+  std::cout << name << ":\n"
+            << "  build: " << build_time << '\n'
+            << "  query: " << query_time << '\n'
+            << "  box tests: " << num_box_tests << '\n'
+            << "  leaves found: " << num_leaves << std::endl;
+}
+
+}  // namespace
+
+// Builds the AABB tree of the first mesh with each split method, and queries it
+// with the bounding boxes of the faces of the second mesh.
+int main(int argc, char* argv[]) {
+  try {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    Triangle_soup a;
+    Triangle_soup b;
+
+    if (!read_triangle_soup(args.at(0), a)) {
+      throw std::runtime_error("failed to read the first mesh");
+    }
+    if (!read_triangle_soup(args.at(1), b)) {
+      throw std::runtime_error("failed to read the second mesh");
+    }
+
+    run(a, b, AABB_split_method::MEDIAN, "median");
+    run(a, b, AABB_split_method::SAH, "sah");
+    run(a, b, AABB_split_method::MORTON, "morton");
+
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  } catch (...) {
+    std::cerr << "unknown error" << std::endl;
+    return 1;
+  }
+}
@@ -1,6 +1,7 @@
 #include <CGAL/Exact_predicates_exact_constructions_kernel.h>
 #include <kigumi/Boolean_operator.h>
 #include <kigumi/Boolean_region_builder.h>
+#include <kigumi/Corefine.h>
 #include <kigumi/Region.h>
 #include <kigumi/Warnings.h>
 
@@ -43,6 +44,7 @@ struct Options {
   std::optional<std::string> output_dif;
   std::optional<std::string> output_sym;
   std::optional<std::string> output_uni;
+  bool lazy{};
 };
 
 }  // namespace
@@ -74,6 +76,8 @@ void Boolean_command::operator()(const std::vector<std::string>& args) const {
        "output the difference of the two meshes")  //
       ("sym", po::value(&opts.output_sym)->value_name("<file>"),
        "output the symmetric difference of the two meshes")  //
+      ("lazy", po::bool_switch(&opts.lazy),
+       "evaluate intersection points exactly only when needed")  //
       ;
 
   po::variables_map vm;
@@ -88,7 +92,7 @@ void Boolean_command::operator()(const std::vector<std::string>& args) const {
     std::cerr << "usage: kigumi boolean [--first] (<file> | :empty: | :full:)\n"
                  "                      [--second] (<file> | :empty: | :full:)\n"
                  "                      [--int <file>] [--uni <file>] [--dif <file>]\n"
-                 "                      [--sym <file>]\n"
+                 "                      [--sym <file>] [--lazy]\n"
                  "\n"
               << opts_desc;
     throw;
@@ -104,6 +108,10 @@ void Boolean_command::operator()(const std::vector<std::string>& args) const {
     throw std::runtime_error("reading failed: " + opts.second);
   }
 
+  kigumi::Corefine_options corefine_opts;
+  corefine_opts.set_lazy_intersection_points(opts.lazy);
+  kigumi::Corefine_context corefine_ctx{corefine_opts};
+
   Boolean_region_builder builder{first, second};
 
   auto warnings = builder.warnings();
@@ -116,6 +124,12 @@ void Boolean_command::operator()(const std::vector<std::string>& args) const {
     std::cerr << "warning: the second mesh partially intersects with the first mesh" << std::endl;
   }
 
+  if (opts.lazy) {
+    std::cout << "Exactly evaluated intersection points: "
+              << builder.num_evaluated_intersection_points() << " of "
+              << builder.num_intersection_points() << std::endl;
+  }
+
   std::vector<std::pair<kigumi::Boolean_operator, std::optional<std::string>>> outputs{
       {kigumi::Boolean_operator::INTERSECTION, opts.output_int},
       {kigumi::Boolean_operator::UNION, opts.output_uni},
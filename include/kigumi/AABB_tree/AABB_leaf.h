@@ -12,6 +12,8 @@ class AABB_leaf {
 
   const Bbox& bbox() const { return bbox_; }
 
+  void set_bbox(const Bbox& bbox) { bbox_ = bbox; }
+
  private:
   Bbox bbox_;
 };
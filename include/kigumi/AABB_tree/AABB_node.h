@@ -2,37 +2,85 @@
 
 #include <CGAL/Bbox_3.h>
 
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
 namespace kigumi {
 
-template <class Leaf>
+namespace internal {
+
+// Returns the largest float that is not greater than x.
+inline float round_down_to_float(double x) {
+  constexpr auto kMax = std::numeric_limits<float>::max();
+  if (x >= kMax) {
+    return kMax;
+  }
+  if (x < -kMax) {
+    return -std::numeric_limits<float>::infinity();
+  }
+  auto f = static_cast<float>(x);
+  return static_cast<double>(f) > x ? std::nextafter(f, -kMax) : f;
+}
+
+// Returns the smallest float that is not less than x.
+inline float round_up_to_float(double x) { return -round_down_to_float(-x); }
+
+}  // namespace internal
+
+// A 32-byte node of the binary tree from which AABB_tree is built.
+//
+// The bounding box is stored in single precision, rounded outward so that it contains
+// the bounding box in double precision. Each child is referenced by a 32-bit integer
+// which is either the index of a node, or a range of one or two leaves.
 class AABB_node {
   using Bbox = CGAL::Bbox_3;
 
  public:
-  const Bbox& bbox() const { return bbox_; }
+  using Child = std::uint32_t;
+
+  static constexpr std::size_t kMaxNumLeavesInChild = 2;
 
-  const AABB_node* left_node() const { return static_cast<const AABB_node*>(left_); }
+  Bbox bbox() const {
+    return {min_[0], min_[1], min_[2], max_[0], max_[1], max_[2]};
+  }
 
-  const AABB_node* right_node() const { return static_cast<const AABB_node*>(right_); }
+  const std::array<Child, 2>& children() const { return children_; }
 
-  const Leaf* left_leaf() const { return static_cast<const Leaf*>(left_); }
+  void set_bbox(const Bbox& bbox) {
+    for (auto i = 0; i < 3; ++i) {
+      min_.at(i) = internal::round_down_to_float(bbox.min(i));
+      max_.at(i) = internal::round_up_to_float(bbox.max(i));
+    }
+  }
 
-  const Leaf* right_leaf() const { return static_cast<const Leaf*>(right_); }
+  void set_children(Child left, Child right) { children_ = {left, right}; }
 
-  void set_bbox(const Bbox& bbox) { bbox_ = bbox; }
+  static Child node_child(std::size_t node_index) { return static_cast<Child>(node_index); }
 
-  void set_left_node(const AABB_node* node) { left_ = node; }
+  static Child leaf_child(std::size_t first_leaf, std::size_t num_leaves) {
+    return kLeafBit | (num_leaves == 2 ? kPairBit : 0) | static_cast<Child>(first_leaf);
+  }
 
-  void set_right_node(const AABB_node* node) { right_ = node; }
+  static bool is_leaf(Child child) { return (child & kLeafBit) != 0; }
 
-  void set_left_leaf(const Leaf* leaf) { left_ = leaf; }
+  // The index of the node, or the index of the first leaf.
+  static std::size_t index(Child child) { return child & kIndexMask; }
 
-  void set_right_leaf(const Leaf* leaf) { right_ = leaf; }
+  static std::size_t num_leaves(Child child) { return (child & kPairBit) != 0 ? 2 : 1; }
 
  private:
-  Bbox bbox_;
-  const void* left_{nullptr};
-  const void* right_{nullptr};
+  static constexpr Child kLeafBit = Child{1} << 31;
+  static constexpr Child kPairBit = Child{1} << 30;
+  static constexpr Child kIndexMask = kPairBit - 1;
+
+  std::array<float, 3> min_{};
+  std::array<float, 3> max_{};
+  std::array<Child, 2> children_{};
 };
 
+static_assert(sizeof(AABB_node) == 32);
+
 }  // namespace kigumi
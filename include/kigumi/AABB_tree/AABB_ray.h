@@ -0,0 +1,83 @@
+#pragma once
+
+#include <CGAL/Bbox_3.h>
+#include <CGAL/Interval_nt.h>
+#include <CGAL/intersections.h>
+#include <kigumi/AABB_tree/AABB_node.h>
+#include <kigumi/AABB_tree/AABB_wide_node.h>
+
+#include <array>
+#include <cmath>
+#include <optional>
+
+namespace kigumi {
+
+// A ray query for AABB_tree, which tests the ray against all children of a node at once with
+// SIMD instructions, given the approximations of its origin and direction.
+//
+// The leaves are tested against the ray itself by do_intersect(bbox, ray), so the results are
+// the same as those of the ray.
+template <class Ray>
+class AABB_ray {
+  using Bbox = CGAL::Bbox_3;
+  using Interval = CGAL::Interval_nt<>;
+  using Interval_vector = std::array<Interval, 3>;
+
+ public:
+  AABB_ray(const Ray& ray, const Interval_vector& origin, const Interval_vector& direction)
+      : ray_{ray} {
+    AABB_wide_node::Ray_slabs slabs;
+    for (auto i = 0; i < 3; ++i) {
+      const auto& o = origin.at(i);
+      const auto& d = direction.at(i);
+
+      // Beyond this, the differences from the bounding boxes may overflow in single precision.
+      if (!(std::abs(o.inf()) <= kMaxOrigin && std::abs(o.sup()) <= kMaxOrigin)) {
+        return;
+      }
+
+      if (d.inf() == 0.0 && d.sup() == 0.0) {
+        slabs.is_parallel.at(i) = true;
+        slabs.origin_min.at(i) = internal::round_down_to_float(o.inf());
+        slabs.origin_max.at(i) = internal::round_up_to_float(o.sup());
+        continue;
+      }
+
+      if (!(d.inf() > 0.0 || d.sup() < 0.0)) {
+        continue;
+      }
+
+      auto inv_dir = Interval{1.0} / d;
+      auto positive = d.inf() > 0.0;
+      slabs.has_direction.at(i) = true;
+      slabs.near_is_min.at(i) = positive;
+      slabs.near_origin.at(i) = positive ? internal::round_up_to_float(o.sup())
+                                         : internal::round_down_to_float(o.inf());
+      slabs.far_origin.at(i) = positive ? internal::round_down_to_float(o.inf())
+                                        : internal::round_up_to_float(o.sup());
+      slabs.inv_dir_min.at(i) = internal::round_down_to_float(inv_dir.inf());
+      slabs.inv_dir_max.at(i) = internal::round_up_to_float(inv_dir.sup());
+    }
+    slabs_ = slabs;
+  }
+
+  const Ray& ray() const { return ray_; }
+
+  // The ray prepared for AABB_wide_node::ray_mask, or std::nullopt if the ray must be tested
+  // against each child by do_intersect.
+  const std::optional<AABB_wide_node::Ray_slabs>& slabs() const { return slabs_; }
+
+  friend bool do_intersect(const Bbox& bbox, const AABB_ray& ray) {
+    using CGAL::do_intersect;
+
+    return do_intersect(bbox, ray.ray_);
+  }
+
+ private:
+  static constexpr double kMaxOrigin = 0x1p100;
+
+  Ray ray_;
+  std::optional<AABB_wide_node::Ray_slabs> slabs_;
+};
+
+}  // namespace kigumi
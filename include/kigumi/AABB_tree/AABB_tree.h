@@ -3,165 +3,911 @@
 #include <CGAL/Bbox_3.h>
 #include <CGAL/intersections.h>
 #include <kigumi/AABB_tree/AABB_node.h>
+#include <kigumi/AABB_tree/AABB_wide_node.h>
+#include <kigumi/Thread_pool.h>
+#include <kigumi/parallel_do.h>
+#include <kigumi/parallel_sort.h>
 #include <kigumi/threading.h>
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <boost/container/small_vector.hpp>
 #include <cmath>
+#include <cstdint>
 #include <iterator>
-#include <thread>
+#include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace kigumi {
 
+// How the leaves of an AABB_tree node are split into its children.
+enum class AABB_split_method : std::uint8_t {
+  // At the median of the centroids along the longest axis of the node.
+  MEDIAN,
+  // At the bin boundary that minimizes the surface area heuristic (SAH) cost.
+  SAH,
+  // Not split top-down, but at the highest differing bit of the Morton codes of the centroids,
+  // which are sorted in parallel (linear BVH). The fastest to build.
+  MORTON,
+};
+
+// A bounding volume hierarchy of leaves.
+//
+// The tree is built as a binary tree with the split method, and then collapsed into a tree of
+// wide nodes (AABB_wide_node), so that the children of a node are tested against a box at once.
 template <class Leaf>
 class AABB_tree {
   using Bbox = CGAL::Bbox_3;
-  using Node = AABB_node<Leaf>;
-  using Node_iterator = typename std::vector<Node>::iterator;
+  using Binary_node = AABB_node;
+  using Child = AABB_node::Child;
+  using Leaf_iterator = typename std::vector<Leaf>::iterator;
+  using Node = AABB_wide_node;
+
+  static constexpr std::size_t kTraversalStackCapacity = 64;
 
  public:
-  explicit AABB_tree(std::vector<Leaf> leaves) : leaves_{std::move(leaves)} {
+  explicit AABB_tree(std::vector<Leaf> leaves,
+                     AABB_split_method split_method = AABB_split_method::MEDIAN)
+      : leaves_{std::move(leaves)}, split_method_{split_method} {
     auto num_leaves = leaves_.size();
-    if (num_leaves == 0) {
-      return;
+    if (num_leaves > Binary_node::index(~Child{})) {
+      throw std::invalid_argument("too many leaves");
     }
 
-    if (num_leaves == 1) {
-      root_ = &leaves_.front();
+    if (num_leaves <= Binary_node::kMaxNumLeavesInChild) {
+      root_ = Binary_node::leaf_child(0, num_leaves);
       return;
     }
 
-    nodes_.resize(num_leaves - 1);
+    // A binary tree with n leaves has at most n - 1 nodes.
+    binary_nodes_.resize(num_leaves - 1);
+    if (split_method_ == AABB_split_method::MORTON) {
+      num_binary_nodes_ = num_leaves - 1;
+      build_lbvh();
+    } else {
+      num_binary_nodes_ = 1;
+      build(0, leaves_.begin(), leaves_.end(), 0);
+    }
+
+    // The wide tree has at most as many nodes as the binary tree.
+    nodes_.resize(num_binary_nodes_);
+    num_nodes_ = 1;
+    root_ = Binary_node::node_child(0);
+    collapse(0, 0, 0);
+    nodes_.resize(num_nodes_);
+    nodes_.shrink_to_fit();
 
-    auto* root = &nodes_.front();
-    root_ = root;
+    // The binary tree is only needed to build the wide tree.
+    binary_nodes_.clear();
+    binary_nodes_.shrink_to_fit();
 
-    build(nodes_.begin(), leaves_.begin(), leaves_.end(), 0);
+    build_cost_ = normalized_cost(refit_node(Node::index(root_), 0));
   }
 
+  AABB_tree(const AABB_tree& other)
+      : leaves_{other.leaves_},
+        split_method_{other.split_method_},
+        nodes_{other.nodes_},
+        root_{other.root_},
+        build_cost_{other.build_cost_} {}
+
+  // Updates the bounding box of each leaf to leaf_bbox(leaf), and refits the bounding boxes
+  // of the nodes bottom-up while keeping the structure of the tree.
+  //
+  // Returns the ratio of the SAH cost (the sum of the areas of the boxes of the nodes relative
+  // to the area of the root box) after refitting to that after building. The larger the ratio,
+  // the more the tree has degraded compared with rebuilding it.
+  template <class LeafBbox>
+  double refit(LeafBbox leaf_bbox) {
+    auto indices = std::views::iota(std::size_t{0}, leaves_.size());
+    parallel_do(indices.begin(), indices.end(), [&](std::size_t i) {
+      auto& leaf = leaves_.at(i);
+      leaf.set_bbox(leaf_bbox(std::as_const(leaf)));
+    });
+
+    if (Node::is_leaf(root_)) {
+      return 1.0;
+    }
+
+    auto cost = normalized_cost(refit_node(Node::index(root_), 0));
+    return build_cost_ > 0.0 ? cost / build_cost_ : 1.0;
+  }
+
+  // Box tests are performed by an unqualified call to do_intersect(bbox, query),
+  // so a query type can provide its own overload.
   template <class OutputIterator, class Query>
   void get_intersecting_leaves(OutputIterator leaves, const Query& query) const {
-    auto num_leaves = leaves_.size();
+    for_each_intersecting_leaf(query, [&](const Leaf& leaf) {
+      *leaves++ = &leaf;
+      return true;
+    });
+  }
 
-    switch (num_leaves) {
-      case 0:
-        break;
+  // Calls visitor(leaf) for each leaf whose bounding box intersects the query, until visitor
+  // returns false. Returns false if the traversal was stopped by visitor.
+  //
+  // The leaves are visited in the same order as they are reported by get_intersecting_leaves.
+  template <class Query, class Visitor>
+  bool for_each_intersecting_leaf(const Query& query, Visitor visitor) const {
+    using CGAL::do_intersect;
+
+    if (leaves_.empty()) {
+      return true;
+    }
 
-      case 1:
-        if (CGAL::do_intersect(root_leaf()->bbox(), query)) {
-          *leaves++ = root_leaf();
+    // The stack does not allocate unless the tree is unusually deep.
+    boost::container::small_vector<Child, kTraversalStackCapacity> stack{root_};
+    while (!stack.empty()) {
+      auto child = stack.back();
+      stack.pop_back();
+
+      if (Node::is_leaf(child)) {
+        auto first = Node::index(child);
+        auto last = first + Node::num_leaves(child);
+        for (auto i = first; i < last; ++i) {
+          const auto& leaf = leaves_.at(i);
+          if (do_intersect(leaf.bbox(), query) && !visitor(leaf)) {
+            return false;
+          }
         }
-        break;
+        continue;
+      }
 
-      default:
-        traverse(leaves, num_leaves, query, root_node());
-        break;
+      // The children are pushed in reverse order, so that they are visited in order.
+      const auto& node = nodes_.at(Node::index(child));
+      auto mask = intersection_mask(node, query);
+      while (mask != 0) {
+        auto i = static_cast<std::size_t>(std::bit_width(mask) - 1);
+        stack.push_back(node.child(i));
+        mask &= ~(1U << i);
+      }
     }
+
+    return true;
   }
 
- private:
-  // NOLINTNEXTLINE(misc-no-recursion)
-  template <class RandomAccessIterator>
-  void build(Node_iterator node_it, RandomAccessIterator first, RandomAccessIterator last,
-             int node_depth) {
-    node_it->set_bbox(bbox_from_leaves(first, last));
+  // Calls body(leaf, other_leaf, local_state) for each pair of a leaf of this tree and a leaf
+  // of other whose bounding boxes intersect, by traversing both trees simultaneously.
+  // The traversal is split into subtree pairs that are processed in parallel; local_state is
+  // created by init() and passed to post(local_state) as in parallel_do.
+  template <class OtherLeaf, class Init, class Body, class Post>
+  void for_each_intersecting_leaf_pair(const AABB_tree<OtherLeaf>& other, Init init, Body body,
+                                       Post post) const {
+    if (leaves_.empty() || other.leaves_.empty()) {
+      return;
+    }
 
-    auto num_leaves = static_cast<std::size_t>(std::distance(first, last));
+    run_traversals(other, {root_, root_bbox(), other.root_, other.root_bbox(), false}, init, body,
+                   post);
+  }
 
-    switch (num_leaves) {
-      case 2:  // (leaf, leaf)
-        node_it->set_left_leaf(&*first);
-        node_it->set_right_leaf(&*(first + 1));
-        break;
+  // Same as above, but for the pairs of distinct leaves of this tree. Each pair is reported once.
+  template <class Init, class Body, class Post>
+  void for_each_intersecting_leaf_pair(Init init, Body body, Post post) const {
+    if (leaves_.empty()) {
+      return;
+    }
+
+    auto bbox = root_bbox();
+    run_traversals(*this, {root_, bbox, root_, bbox, true}, init, body, post);
+  }
+
+  // Visits the leaves whose bounding boxes intersect the query, in increasing order of
+  // lower_bound(bbox). visitor(leaf) returns a distance bound, and the subtrees and leaves whose
+  // lower bounds exceed the latest bound are skipped. Returning -infinity stops the traversal.
+  //
+  // lower_bound(bbox) must not exceed the distance of any point of the box that matters
+  // to the visitor, e.g., the distance along a ray for a closest-hit query.
+  template <class Query, class LowerBound, class Visitor>
+  void for_each_intersecting_leaf_by_distance(const Query& query, LowerBound lower_bound,
+                                              Visitor visitor) const {
+    using CGAL::do_intersect;
+
+    if (leaves_.empty()) {
+      return;
+    }
+
+    struct Entry {
+      double distance;
+      // A node, or a single leaf whose bounding box intersects the query.
+      Child child;
+    };
+
+    // A min-heap of the entries.
+    boost::container::small_vector<Entry, kTraversalStackCapacity> heap;
+    auto greater = [](const Entry& a, const Entry& b) { return a.distance > b.distance; };
+    auto push = [&](double distance, Child child) {
+      heap.push_back({distance, child});
+      std::push_heap(heap.begin(), heap.end(), greater);
+    };
+    auto push_child = [&](Child child, const Bbox& bbox) {
+      if (!Node::is_leaf(child)) {
+        push(lower_bound(bbox), child);
+        return;
+      }
 
-      case 3:  // (leaf, node)
-      {
-        auto right_node_it = node_it + 1;
-        auto split_axis = bbox_longest_axis(node_it->bbox());
-        std::sort(first, last, [split_axis](const auto& a, const auto& b) {
-          return bbox_center(a.bbox()).at(split_axis) < bbox_center(b.bbox()).at(split_axis);
-        });
+      auto first = Node::index(child);
+      auto last = first + Node::num_leaves(child);
+      for (auto i = first; i < last; ++i) {
+        const auto& leaf = leaves_.at(i);
+        if (do_intersect(leaf.bbox(), query)) {
+          push(lower_bound(leaf.bbox()), Binary_node::leaf_child(i, 1));
+        }
+      }
+    };
 
-        node_it->set_left_leaf(&*first);
-        node_it->set_right_node(&*right_node_it);
+    push_child(root_, root_bbox());
+    auto bound = std::numeric_limits<double>::infinity();
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      auto [distance, child] = heap.back();
+      heap.pop_back();
 
-        build(right_node_it, first + 1, last, node_depth + 1);
+      if (distance > bound) {
         break;
       }
 
-      default:  // (node, node)
-      {
-        auto num_left_leaves = num_leaves / 2;
-        auto middle = first + num_left_leaves;
-        auto left_node_it = node_it + 1;
-        // The left tree requires (num_left_leaves - 1) nodes.
-        auto right_node_it = node_it + num_left_leaves;
-        auto split_axis = bbox_longest_axis(node_it->bbox());
-        std::nth_element(first, middle, last, [split_axis](const auto& a, const auto& b) {
-          return bbox_center(a.bbox()).at(split_axis) < bbox_center(b.bbox()).at(split_axis);
-        });
-
-        node_it->set_left_node(&*left_node_it);
-        node_it->set_right_node(&*right_node_it);
-
-        if (node_depth < concurrency_depth_limit_) {
-          std::thread left_thread(&AABB_tree::build<RandomAccessIterator>, this, left_node_it,
-                                  first, middle, node_depth + 1);
-          std::thread right_thread(&AABB_tree::build<RandomAccessIterator>, this, right_node_it,
-                                   middle, last, node_depth + 1);
-          left_thread.join();
-          right_thread.join();
+      if (Node::is_leaf(child)) {
+        bound = visitor(leaves_.at(Node::index(child)));
+        continue;
+      }
+
+      const auto& node = nodes_.at(Node::index(child));
+      for_each_bit(intersection_mask(node, query),
+                   [&](auto i) { push_child(node.child(i), node.child_bbox(i)); });
+    }
+  }
+
+ private:
+  template <class>
+  friend class AABB_tree;
+
+  // The traversal of the subtree pair (a, b), or of subtree a with itself if self is true.
+  struct Traversal {
+    Child a;
+    Bbox a_bbox;
+    Child b;
+    Bbox b_bbox;
+    bool self;
+  };
+
+  template <class OtherLeaf, class Init, class Body, class Post>
+  void run_traversals(const AABB_tree<OtherLeaf>& other, Traversal root, Init& init, Body& body,
+                      Post& post) const {
+    auto traversals = split_traversal(other, root);
+
+    parallel_do(
+        traversals.begin(), traversals.end(), init,
+        [&](const Traversal& traversal, auto& local_state) {
+          auto f = [&](const Leaf& leaf, const OtherLeaf& other_leaf) {
+            body(leaf, other_leaf, local_state);
+          };
+          if (traversal.self) {
+            self_traverse(traversal.a, f);
+          } else {
+            dual_traverse(other, traversal.a, traversal.a_bbox, traversal.b, traversal.b_bbox, f);
+          }
+        },
+        post, 1);
+  }
+
+  // Expands the traversal breadth-first until there are enough subtree pairs to balance the load.
+  template <class OtherLeaf>
+  std::vector<Traversal> split_traversal(const AABB_tree<OtherLeaf>& other,
+                                         Traversal root) const {
+    std::vector<Traversal> traversals{root};
+    auto min_num_traversals = 64 * Threading_context::current().num_threads();
+
+    while (traversals.size() < min_num_traversals) {
+      std::vector<Traversal> next;
+      auto expanded = false;
+
+      for (const auto& t : traversals) {
+        if (t.self) {
+          if (Node::is_leaf(t.a)) {
+            next.push_back(t);
+            continue;
+          }
+
+          const auto& node = nodes_.at(Node::index(t.a));
+          for (std::size_t i = 0; i < node.num_children(); ++i) {
+            next.push_back({node.child(i), node.child_bbox(i), node.child(i), {}, true});
+          }
+          for (std::size_t i = 0; i < node.num_children(); ++i) {
+            for_each_bit(node.overlap_mask(node.child_bbox(i)) & higher_bits(i), [&](auto j) {
+              next.push_back({node.child(i), node.child_bbox(i), node.child(j), node.child_bbox(j),
+                              false});
+            });
+          }
         } else {
-          build(left_node_it, first, middle, node_depth + 1);
-          build(right_node_it, middle, last, node_depth + 1);
+          if (Node::is_leaf(t.a) && Node::is_leaf(t.b)) {
+            next.push_back(t);
+            continue;
+          }
+
+          if (descends_first(t.a, t.a_bbox, t.b, t.b_bbox)) {
+            const auto& node = nodes_.at(Node::index(t.a));
+            for_each_bit(node.overlap_mask(t.b_bbox), [&](auto i) {
+              next.push_back({node.child(i), node.child_bbox(i), t.b, t.b_bbox, false});
+            });
+          } else {
+            const auto& node = other.nodes_.at(Node::index(t.b));
+            for_each_bit(node.overlap_mask(t.a_bbox), [&](auto i) {
+              next.push_back({t.a, t.a_bbox, node.child(i), node.child_bbox(i), false});
+            });
+          }
         }
+        expanded = true;
+      }
+
+      traversals = std::move(next);
+      if (!expanded) {
         break;
       }
     }
+
+    return traversals;
   }
 
-  template <class OutputIterator, class Query>
+  // Whether the dual traversal of (a, b) descends into a rather than b. The larger subtree
+  // is descended first, so that the boxes compared are of similar sizes.
+  static bool descends_first(Child a, const Bbox& a_bbox, Child b, const Bbox& b_bbox) {
+    if (Node::is_leaf(a)) {
+      return false;
+    }
+    if (Node::is_leaf(b)) {
+      return true;
+    }
+    return half_area(a_bbox) >= half_area(b_bbox);
+  }
+
+  template <class OtherLeaf, class F>
   // NOLINTNEXTLINE(misc-no-recursion)
-  void traverse(OutputIterator leaves, std::size_t num_leaves, const Query& query,
-                const Node* node) const {
-    switch (num_leaves) {
-      case 2:  // (leaf, leaf)
-        if (CGAL::do_intersect(node->left_leaf()->bbox(), query)) {
-          *leaves++ = node->left_leaf();
+  void dual_traverse(const AABB_tree<OtherLeaf>& other, Child a, const Bbox& a_bbox, Child b,
+                     const Bbox& b_bbox, F& f) const {
+    if (Node::is_leaf(a) && Node::is_leaf(b)) {
+      auto a_first = Node::index(a);
+      auto a_last = a_first + Node::num_leaves(a);
+      auto b_first = Node::index(b);
+      auto b_last = b_first + Node::num_leaves(b);
+      for (auto i = a_first; i < a_last; ++i) {
+        const auto& leaf = leaves_.at(i);
+        for (auto j = b_first; j < b_last; ++j) {
+          const auto& other_leaf = other.leaves_.at(j);
+          if (CGAL::do_overlap(leaf.bbox(), other_leaf.bbox())) {
+            f(leaf, other_leaf);
+          }
         }
-        if (CGAL::do_intersect(node->right_leaf()->bbox(), query)) {
-          *leaves++ = node->right_leaf();
+      }
+      return;
+    }
+
+    if (descends_first(a, a_bbox, b, b_bbox)) {
+      const auto& node = nodes_.at(Node::index(a));
+      for_each_bit(node.overlap_mask(b_bbox), [&](auto i) {
+        dual_traverse(other, node.child(i), node.child_bbox(i), b, b_bbox, f);
+      });
+    } else {
+      const auto& node = other.nodes_.at(Node::index(b));
+      for_each_bit(node.overlap_mask(a_bbox), [&](auto i) {
+        dual_traverse(other, a, a_bbox, node.child(i), node.child_bbox(i), f);
+      });
+    }
+  }
+
+  template <class F>
+  // NOLINTNEXTLINE(misc-no-recursion)
+  void self_traverse(Child a, F& f) const {
+    if (Node::is_leaf(a)) {
+      auto first = Node::index(a);
+      auto last = first + Node::num_leaves(a);
+      for (auto i = first; i < last; ++i) {
+        for (auto j = i + 1; j < last; ++j) {
+          if (CGAL::do_overlap(leaves_.at(i).bbox(), leaves_.at(j).bbox())) {
+            f(leaves_.at(i), leaves_.at(j));
+          }
         }
-        break;
+      }
+      return;
+    }
+
+    const auto& node = nodes_.at(Node::index(a));
+    for (std::size_t i = 0; i < node.num_children(); ++i) {
+      self_traverse(node.child(i), f);
+    }
+    for (std::size_t i = 0; i < node.num_children(); ++i) {
+      auto bbox = node.child_bbox(i);
+      for_each_bit(node.overlap_mask(bbox) & higher_bits(i), [&](auto j) {
+        dual_traverse(*this, node.child(i), bbox, node.child(j), node.child_bbox(j), f);
+      });
+    }
+  }
+
+  // Calls f(i) for each bit i set in mask, in increasing order.
+  template <class F>
+  static void for_each_bit(unsigned mask, F f) {
+    while (mask != 0) {
+      f(static_cast<std::size_t>(std::countr_zero(mask)));
+      mask &= mask - 1;
+    }
+  }
+
+  // The mask of the bits above bit i.
+  static unsigned higher_bits(std::size_t i) { return ~((2U << i) - 1); }
+
+  // Refits the bounding boxes of the children of the node, and returns the bounding box of
+  // the node and the sum of the areas of the boxes of the node's descendants.
+  // NOLINTNEXTLINE(misc-no-recursion)
+  std::pair<Bbox, double> refit_node(std::size_t node_index, int node_depth) {
+    auto& node = nodes_.at(node_index);
+    auto num_children = node.num_children();
+    std::array<Bbox, Node::kMaxNumChildren> bboxes{};
+    std::array<double, Node::kMaxNumChildren> costs{};
+
+    auto refit_child = [&, node_depth](std::size_t i) {
+      auto child = node.child(i);
+      if (Node::is_leaf(child)) {
+        auto first = leaves_.begin() + static_cast<std::ptrdiff_t>(Node::index(child));
+        bboxes.at(i) =
+            bbox_from_leaves(first, first + static_cast<std::ptrdiff_t>(Node::num_leaves(child)));
+      } else {
+        std::tie(bboxes.at(i), costs.at(i)) = refit_node(Node::index(child), node_depth + 1);
+      }
+    };
+
+    if (node_depth < concurrency_depth_limit_) {
+      Task_group group;
+      for (std::size_t i = 0; i + 1 < num_children; ++i) {
+        group.run([&, i] { refit_child(i); });
+      }
+      refit_child(num_children - 1);
+      group.wait();
+    } else {
+      for (std::size_t i = 0; i < num_children; ++i) {
+        refit_child(i);
+      }
+    }
+
+    Bbox bbox;
+    auto cost = 0.0;
+    for (std::size_t i = 0; i < num_children; ++i) {
+      node.set_child_bbox(i, bboxes.at(i));
+      bbox += bboxes.at(i);
+      cost += half_area(bboxes.at(i)) + costs.at(i);
+    }
+    return {bbox, cost};
+  }
+
+  static double normalized_cost(const std::pair<Bbox, double>& refit_result) {
+    auto [bbox, cost] = refit_result;
+    auto area = half_area(bbox);
+    return area > 0.0 ? cost / area : 0.0;
+  }
+
+  Bbox root_bbox() const {
+    if (!Node::is_leaf(root_)) {
+      return nodes_.at(Node::index(root_)).bbox();
+    }
+
+    auto first = leaves_.begin() + static_cast<std::ptrdiff_t>(Node::index(root_));
+    return bbox_from_leaves(first, first + static_cast<std::ptrdiff_t>(Node::num_leaves(root_)));
+  }
+
+  Bbox binary_child_bbox(Child child) const {
+    if (!Binary_node::is_leaf(child)) {
+      return binary_nodes_.at(Binary_node::index(child)).bbox();
+    }
+
+    auto first = leaves_.begin() + static_cast<std::ptrdiff_t>(Binary_node::index(child));
+    return bbox_from_leaves(first,
+                            first + static_cast<std::ptrdiff_t>(Binary_node::num_leaves(child)));
+  }
+
+  // NOLINTNEXTLINE(misc-no-recursion)
+  void build(std::size_t node_index, Leaf_iterator first, Leaf_iterator last, int node_depth) {
+    auto bbox = bbox_from_leaves(first, last);
+    auto num_leaves = static_cast<std::size_t>(std::distance(first, last));
+    auto num_left_leaves = split_method_ == AABB_split_method::SAH
+                               ? sah_split(first, last)
+                               : median_split(first, last, bbox);
+    auto num_right_leaves = num_leaves - num_left_leaves;
+    auto middle = first + static_cast<std::ptrdiff_t>(num_left_leaves);
+
+    // The child nodes are allocated next to each other.
+    auto left_is_node = num_left_leaves > Binary_node::kMaxNumLeavesInChild;
+    auto right_is_node = num_right_leaves > Binary_node::kMaxNumLeavesInChild;
+    auto num_child_nodes = static_cast<std::size_t>(left_is_node) + right_is_node;
+    auto left_index = num_binary_nodes_.fetch_add(num_child_nodes, std::memory_order_relaxed);
+    auto right_index = left_index + left_is_node;
+
+    auto& node = binary_nodes_.at(node_index);
+    node.set_bbox(bbox);
+    node.set_children(
+        left_is_node ? Binary_node::node_child(left_index)
+                     : Binary_node::leaf_child(leaf_index(first), num_left_leaves),
+        right_is_node ? Binary_node::node_child(right_index)
+                      : Binary_node::leaf_child(leaf_index(middle), num_right_leaves));
+
+    if (left_is_node && right_is_node && node_depth < concurrency_depth_limit_) {
+      Task_group group;
+      group.run([=, this] { build(left_index, first, middle, node_depth + 1); });
+      build(right_index, middle, last, node_depth + 1);
+      group.wait();
+      return;
+    }
 
-      case 3:  // (leaf, node)
-        if (CGAL::do_intersect(node->left_leaf()->bbox(), query)) {
-          *leaves++ = node->left_leaf();
+    if (left_is_node) {
+      build(left_index, first, middle, node_depth + 1);
+    }
+    if (right_is_node) {
+      build(right_index, middle, last, node_depth + 1);
+    }
+  }
+
+  // Builds the binary tree as a linear BVH [Karras 2012]: the leaves are sorted by the Morton
+  // codes of their centroids, and then the range of leaves and the split position of each node
+  // are determined independently from the codes. The node i has the leaf i or i + 1 at one end
+  // of its range, and the node 0 is the root. The bounding boxes are computed bottom-up, by the
+  // thread that finishes the second child of each node.
+  void build_lbvh() {
+    auto num_leaves = leaves_.size();
+    auto indices = std::views::iota(std::size_t{0}, num_leaves);
+
+    Bbox centroid_bbox;
+    parallel_do(
+        leaves_.begin(), leaves_.end(), [] { return Bbox{}; },
+        [](const Leaf& leaf, Bbox& local_bbox) {
+          auto c = bbox_center(leaf.bbox());
+          local_bbox += Bbox{c[0], c[1], c[2], c[0], c[1], c[2]};
+        },
+        [&](const Bbox& local_bbox) { centroid_bbox += local_bbox; });
+
+    std::vector<std::pair<std::uint64_t, std::size_t>> codes(num_leaves);
+    parallel_do(indices.begin(), indices.end(), [&](std::size_t i) {
+      codes.at(i) = {morton_code(bbox_center(leaves_.at(i).bbox()), centroid_bbox), i};
+    });
+    parallel_sort(codes.begin(), codes.end());
+
+    auto sorted_leaves = leaves_;
+    parallel_do(indices.begin(), indices.end(),
+                [&](std::size_t i) { sorted_leaves.at(i) = leaves_.at(codes.at(i).second); });
+    leaves_ = std::move(sorted_leaves);
+
+    // The length of the common prefix of the keys of the leaves i and j, where the key is
+    // the code followed by the index, or -1 if j is out of range.
+    auto delta = [&](std::ptrdiff_t i, std::ptrdiff_t j) -> int {
+      if (j < 0 || j >= static_cast<std::ptrdiff_t>(num_leaves)) {
+        return -1;
+      }
+      auto a = codes.at(i).first;
+      auto b = codes.at(j).first;
+      return a != b ? std::countl_zero(a ^ b)
+                    : 64 + std::countl_zero(static_cast<std::uint64_t>(i ^ j));
+    };
+
+    // The children of the nodes, each of which is a single leaf or a node.
+    std::vector<std::array<Child, 2>> children(num_leaves - 1);
+    std::vector<std::size_t> leaf_parents(num_leaves);
+    std::vector<std::size_t> node_parents(num_leaves - 1);
+    auto node_indices = std::views::iota(std::size_t{0}, num_leaves - 1);
+    parallel_do(node_indices.begin(), node_indices.end(), [&](std::size_t node_index) {
+      auto i = static_cast<std::ptrdiff_t>(node_index);
+
+      // The direction of the range, and its other end j.
+      auto d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+      auto delta_min = delta(i, i - d);
+      std::ptrdiff_t l_max = 2;
+      while (delta(i, i + l_max * d) > delta_min) {
+        l_max *= 2;
+      }
+      std::ptrdiff_t l = 0;
+      for (auto t = l_max / 2; t >= 1; t /= 2) {
+        if (delta(i, i + (l + t) * d) > delta_min) {
+          l += t;
+        }
+      }
+      auto j = i + l * d;
+
+      // The split position gamma, where the children are [first, gamma] and [gamma + 1, last].
+      auto delta_node = delta(i, j);
+      std::ptrdiff_t s = 0;
+      for (std::ptrdiff_t div = 2;; div *= 2) {
+        auto t = (l + div - 1) / div;
+        if (delta(i, i + (s + t) * d) > delta_node) {
+          s += t;
         }
-        if (CGAL::do_intersect(node->right_node()->bbox(), query)) {
-          traverse(leaves, 2, query, node->right_node());
+        if (t == 1) {
+          break;
         }
-        break;
+      }
+      auto gamma = static_cast<std::size_t>(i + s * d + std::min(d, 0));
+      auto first = static_cast<std::size_t>(std::min(i, j));
+      auto last = static_cast<std::size_t>(std::max(i, j));
+
+      auto& node_children = children.at(node_index);
+      if (first == gamma) {
+        node_children[0] = Binary_node::leaf_child(gamma, 1);
+        leaf_parents.at(gamma) = node_index;
+      } else {
+        node_children[0] = Binary_node::node_child(gamma);
+        node_parents.at(gamma) = node_index;
+      }
+      if (last == gamma + 1) {
+        node_children[1] = Binary_node::leaf_child(gamma + 1, 1);
+        leaf_parents.at(gamma + 1) = node_index;
+      } else {
+        node_children[1] = Binary_node::node_child(gamma + 1);
+        node_parents.at(gamma + 1) = node_index;
+      }
 
-      default:  // (node, node)
-      {
-        auto num_left_leaves = num_leaves / 2;
-        if (CGAL::do_intersect(node->left_node()->bbox(), query)) {
-          traverse(leaves, num_left_leaves, query, node->left_node());
+      // Ranges of up to two leaves are stored in the parent, as in the top-down build.
+      auto left_size = gamma - first + 1;
+      auto right_size = last - gamma;
+      binary_nodes_.at(node_index)
+          .set_children(left_size <= Binary_node::kMaxNumLeavesInChild
+                            ? Binary_node::leaf_child(first, left_size)
+                            : node_children[0],
+                        right_size <= Binary_node::kMaxNumLeavesInChild
+                            ? Binary_node::leaf_child(gamma + 1, right_size)
+                            : node_children[1]);
+    });
+
+    auto karras_child_bbox = [&](Child child) {
+      return Binary_node::is_leaf(child) ? leaves_.at(Binary_node::index(child)).bbox()
+                                         : binary_nodes_.at(Binary_node::index(child)).bbox();
+    };
+
+    std::vector<std::atomic<std::uint32_t>> num_visits(num_leaves - 1);
+    parallel_do(indices.begin(), indices.end(), [&](std::size_t leaf_index) {
+      auto node_index = leaf_parents.at(leaf_index);
+      while (num_visits.at(node_index).fetch_add(1, std::memory_order_acq_rel) == 1) {
+        const auto& [left, right] = children.at(node_index);
+        binary_nodes_.at(node_index).set_bbox(karras_child_bbox(left) + karras_child_bbox(right));
+        if (node_index == 0) {
+          break;
         }
-        if (CGAL::do_intersect(node->right_node()->bbox(), query)) {
-          traverse(leaves, num_leaves - num_left_leaves, query, node->right_node());
+        node_index = node_parents.at(node_index);
+      }
+    });
+  }
+
+  // Returns the 63-bit Morton code of the point, quantized in bbox with 21 bits per axis.
+  static std::uint64_t morton_code(const std::array<double, 3>& p, const Bbox& bbox) {
+    constexpr std::uint64_t kNumCells = std::uint64_t{1} << 21;
+
+    std::uint64_t code{};
+    for (auto axis = 0; axis < 3; ++axis) {
+      auto extent = bbox.max(axis) - bbox.min(axis);
+      auto t = extent > 0.0 ? (p.at(axis) - bbox.min(axis)) / extent : 0.0;
+      auto cell = std::min(static_cast<std::uint64_t>(t * static_cast<double>(kNumCells)),
+                           kNumCells - 1);
+      code |= spread_bits(cell) << (2 - axis);
+    }
+    return code;
+  }
+
+  // Inserts two zero bits between the lower 21 bits of x.
+  static std::uint64_t spread_bits(std::uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffff;
+    x = (x | x << 16) & 0x1f0000ff0000ff;
+    x = (x | x << 8) & 0x100f00f00f00f00f;
+    x = (x | x << 4) & 0x10c30c30c30c30c3;
+    x = (x | x << 2) & 0x1249249249249249;
+    return x;
+  }
+
+  // Collapses the binary subtree rooted at the binary node into the wide node. The inner child
+  // with the largest box is replaced by its children until the wide node is full.
+  // NOLINTNEXTLINE(misc-no-recursion)
+  void collapse(std::size_t binary_node_index, std::size_t node_index, int node_depth) {
+    std::array<Child, Node::kMaxNumChildren> children{};
+    std::array<Bbox, Node::kMaxNumChildren> bboxes{};
+    std::size_t num_children{};
+    for (auto child : binary_nodes_.at(binary_node_index).children()) {
+      children.at(num_children) = child;
+      bboxes.at(num_children) = binary_child_bbox(child);
+      ++num_children;
+    }
+
+    while (num_children < Node::kMaxNumChildren) {
+      auto best = Node::kMaxNumChildren;
+      auto best_area = -1.0;
+      for (std::size_t i = 0; i < num_children; ++i) {
+        if (!Binary_node::is_leaf(children.at(i)) && half_area(bboxes.at(i)) > best_area) {
+          best = i;
+          best_area = half_area(bboxes.at(i));
         }
+      }
+      if (best == Node::kMaxNumChildren) {
         break;
       }
+
+      auto [left, right] = binary_nodes_.at(Binary_node::index(children.at(best))).children();
+      children.at(best) = left;
+      bboxes.at(best) = binary_child_bbox(left);
+      children.at(num_children) = right;
+      bboxes.at(num_children) = binary_child_bbox(right);
+      ++num_children;
+    }
+
+    // The child nodes are allocated next to each other.
+    std::size_t num_child_nodes{};
+    for (std::size_t i = 0; i < num_children; ++i) {
+      num_child_nodes += !Binary_node::is_leaf(children.at(i));
+    }
+    auto child_index = num_nodes_.fetch_add(num_child_nodes, std::memory_order_relaxed);
+
+    // The pairs of the index of a binary node and the index of the node it is collapsed into.
+    std::array<std::pair<std::size_t, std::size_t>, Node::kMaxNumChildren> child_nodes{};
+    std::size_t num_collapsed{};
+    auto& node = nodes_.at(node_index);
+    for (std::size_t i = 0; i < num_children; ++i) {
+      auto child = children.at(i);
+      if (!Binary_node::is_leaf(child)) {
+        child_nodes.at(num_collapsed++) = {Binary_node::index(child), child_index};
+        child = Binary_node::node_child(child_index++);
+      }
+      node.add_child(child, bboxes.at(i));
+    }
+
+    if (num_child_nodes > 1 && node_depth < concurrency_depth_limit_) {
+      Task_group group;
+      for (std::size_t i = 0; i + 1 < num_child_nodes; ++i) {
+        auto [binary_child_index, child_node_index] = child_nodes.at(i);
+        group.run([=, this] { collapse(binary_child_index, child_node_index, node_depth + 1); });
+      }
+      auto [binary_child_index, child_node_index] = child_nodes.at(num_child_nodes - 1);
+      collapse(binary_child_index, child_node_index, node_depth + 1);
+      group.wait();
+      return;
+    }
+
+    for (std::size_t i = 0; i < num_child_nodes; ++i) {
+      auto [binary_child_index, child_node_index] = child_nodes.at(i);
+      collapse(binary_child_index, child_node_index, node_depth + 1);
     }
   }
 
-  const Node* root_node() const { return static_cast<const Node*>(root_); }
+  // Partitions the leaves at the median of the centroids along the longest axis of bbox,
+  // and returns the number of leaves in the left child.
+  template <class RandomAccessIterator>
+  static std::size_t median_split(RandomAccessIterator first, RandomAccessIterator last,
+                                  const Bbox& bbox) {
+    auto num_leaves = static_cast<std::size_t>(std::distance(first, last));
+    auto num_left_leaves = num_leaves / 2;
+    auto split_axis = bbox_longest_axis(bbox);
+    std::nth_element(first, first + static_cast<std::ptrdiff_t>(num_left_leaves), last,
+                     [split_axis](const auto& a, const auto& b) {
+                       return bbox_center(a.bbox()).at(split_axis) <
+                              bbox_center(b.bbox()).at(split_axis);
+                     });
+    return num_left_leaves;
+  }
+
+  // Partitions the leaves with the binned SAH: the centroids are binned along each axis,
+  // and the leaves are split at the bin boundary that minimizes
+  //
+  //   area(left bbox) * (# of left leaves) + area(right bbox) * (# of right leaves).
+  //
+  // Falls back to the median split if the centroids cannot be separated by bins.
+  // Returns the number of leaves in the left child.
+  template <class RandomAccessIterator>
+  static std::size_t sah_split(RandomAccessIterator first, RandomAccessIterator last) {
+    constexpr std::size_t kNumBins = 16;
+
+    auto num_leaves = static_cast<std::size_t>(std::distance(first, last));
+    Bbox centroid_bbox;
+    for (auto it = first; it != last; ++it) {
+      auto c = bbox_center(it->bbox());
+      centroid_bbox += Bbox{c[0], c[1], c[2], c[0], c[1], c[2]};
+    }
+
+    auto best_cost = std::numeric_limits<double>::infinity();
+    auto best_axis = -1;
+    std::size_t best_bin{};
 
-  const Leaf* root_leaf() const { return static_cast<const Leaf*>(root_); }
+    for (auto axis = 0; axis < 3; ++axis) {
+      auto min = centroid_bbox.min(axis);
+      auto extent = centroid_bbox.max(axis) - min;
+      if (!(extent > 0.0)) {
+        continue;
+      }
+
+      auto bin_of = [&](const Leaf& leaf) {
+        auto t = (bbox_center(leaf.bbox()).at(axis) - min) / extent;
+        return std::min(static_cast<std::size_t>(t * kNumBins), kNumBins - 1);
+      };
+
+      std::array<std::size_t, kNumBins> counts{};
+      std::array<Bbox, kNumBins> bboxes{};
+      for (auto it = first; it != last; ++it) {
+        auto bin = bin_of(*it);
+        ++counts.at(bin);
+        bboxes.at(bin) += it->bbox();
+      }
+
+      // right_costs[i] is the cost of the bins [i + 1, kNumBins).
+      std::array<double, kNumBins> right_costs{};
+      Bbox right_bbox;
+      std::size_t num_right_leaves{};
+      for (auto i = kNumBins - 1; i > 0; --i) {
+        right_bbox += bboxes.at(i);
+        num_right_leaves += counts.at(i);
+        right_costs.at(i - 1) =
+            num_right_leaves == 0 ? 0.0 : half_area(right_bbox) * num_right_leaves;
+      }
+
+      Bbox left_bbox;
+      std::size_t num_left_leaves{};
+      for (std::size_t i = 0; i < kNumBins - 1; ++i) {
+        left_bbox += bboxes.at(i);
+        num_left_leaves += counts.at(i);
+        if (num_left_leaves == 0 || num_left_leaves == num_leaves) {
+          continue;
+        }
+
+        auto cost = half_area(left_bbox) * num_left_leaves + right_costs.at(i);
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_bin = i;
+        }
+      }
+    }
+
+    if (best_axis < 0) {
+      return median_split(first, last, centroid_bbox);
+    }
+
+    auto min = centroid_bbox.min(best_axis);
+    auto extent = centroid_bbox.max(best_axis) - min;
+    auto middle = std::partition(first, last, [&](const Leaf& leaf) {
+      auto t = (bbox_center(leaf.bbox()).at(best_axis) - min) / extent;
+      return std::min(static_cast<std::size_t>(t * kNumBins), kNumBins - 1) <= best_bin;
+    });
+    return static_cast<std::size_t>(std::distance(first, middle));
+  }
+
+  // Returns the bit mask of the children of the node whose bounding boxes intersect the query.
+  // Box queries, and ray queries (AABB_ray) if SIMD instructions are available, are tested
+  // against all children at once. As the latter is conservative, the mask may include children
+  // that the ray misses, which the leaf tests rule out.
+  template <class Query>
+  static unsigned intersection_mask(const Node& node, const Query& query) {
+    using CGAL::do_intersect;
+
+    if constexpr (std::is_same_v<Query, Bbox>) {
+      return node.overlap_mask(query);
+    } else {
+#ifdef KIGUMI_AABB_WIDE_NODE_SSE
+      if constexpr (requires { node.ray_mask(*query.slabs()); }) {
+        if (query.slabs()) {
+          return node.ray_mask(*query.slabs());
+        }
+      }
+#endif
+
+      unsigned mask{};
+      for (std::size_t i = 0; i < node.num_children(); ++i) {
+        if (do_intersect(node.child_bbox(i), query)) {
+          mask |= 1U << i;
+        }
+      }
+      return mask;
+    }
+  }
+
+  std::size_t leaf_index(Leaf_iterator it) {
+    return static_cast<std::size_t>(std::distance(leaves_.begin(), it));
+  }
 
   static std::array<double, 3> bbox_center(const Bbox& bbox) {
     return {(bbox.xmax() + bbox.xmin()) / 2.0, (bbox.ymax() + bbox.ymin()) / 2.0,
@@ -177,6 +923,13 @@ class AABB_tree {
     return bbox;
   }
 
+  static double half_area(const Bbox& bbox) {
+    auto dx = bbox.xmax() - bbox.xmin();
+    auto dy = bbox.ymax() - bbox.ymin();
+    auto dz = bbox.zmax() - bbox.zmin();
+    return dx * dy + dy * dz + dz * dx;
+  }
+
   static int bbox_longest_axis(const Bbox& bbox) {
     std::array<double, 3> lengths{bbox.xmax() - bbox.xmin(), bbox.ymax() - bbox.ymin(),
                                   bbox.zmax() - bbox.zmin()};
@@ -187,8 +940,13 @@ class AABB_tree {
   int concurrency_depth_limit_{
       static_cast<int>(std::log2(Threading_context::current().num_threads()))};
   std::vector<Leaf> leaves_;
+  AABB_split_method split_method_;
+  std::vector<Binary_node> binary_nodes_;
+  std::atomic<std::size_t> num_binary_nodes_{};
   std::vector<Node> nodes_;
-  const void* root_{nullptr};
+  std::atomic<std::size_t> num_nodes_{};
+  Child root_{};
+  double build_cost_{};
 };
 
 }  // namespace kigumi
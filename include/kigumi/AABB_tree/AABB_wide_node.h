@@ -0,0 +1,175 @@
+#pragma once
+
+#include <CGAL/Bbox_3.h>
+#include <kigumi/AABB_tree/AABB_node.h>
+
+#include <array>
+#include <cstddef>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define KIGUMI_AABB_WIDE_NODE_SSE
+#endif
+
+namespace kigumi {
+
+// A node of AABB_tree with up to four children, collapsed from the binary tree (AABB_node)
+// built by the split method.
+//
+// The bounding boxes of the children are stored in single precision in SoA layout, rounded
+// outward, so that a box can be tested against all of them at once with SIMD instructions.
+// Children are referenced in the same way as in AABB_node.
+class alignas(16) AABB_wide_node {
+  using Bbox = CGAL::Bbox_3;
+
+ public:
+  using Child = AABB_node::Child;
+
+  static constexpr std::size_t kMaxNumChildren = 4;
+
+  // A ray o + t d (t >= 0) prepared for ray_mask. For each axis along which the sign of d is
+  // known, the slab test enters the children at (near - near_origin) / d and leaves them at
+  // (far - far_origin) / d, where near and far are their min and max in the direction of d,
+  // and near_origin and far_origin are the bounds of o that make the interval of t the widest.
+  // Along an axis where d is zero, the children are kept if [origin_min, origin_max] overlaps
+  // [min, max]. The bounds are rounded outward to single precision.
+  struct Ray_slabs {
+    std::array<bool, 3> has_direction{};
+    std::array<bool, 3> is_parallel{};
+    std::array<float, 3> origin_min{};
+    std::array<float, 3> origin_max{};
+    std::array<bool, 3> near_is_min{};
+    std::array<float, 3> near_origin{};
+    std::array<float, 3> far_origin{};
+    std::array<float, 3> inv_dir_min{};
+    std::array<float, 3> inv_dir_max{};
+  };
+
+  std::size_t num_children() const { return num_children_; }
+
+  Child child(std::size_t i) const { return children_.at(i); }
+
+  Bbox child_bbox(std::size_t i) const {
+    return {min_[0].at(i), min_[1].at(i), min_[2].at(i),
+            max_[0].at(i), max_[1].at(i), max_[2].at(i)};
+  }
+
+  Bbox bbox() const {
+    Bbox bbox;
+    for (std::size_t i = 0; i < num_children_; ++i) {
+      bbox += child_bbox(i);
+    }
+    return bbox;
+  }
+
+  void add_child(Child child, const Bbox& bbox) {
+    auto i = num_children_++;
+    children_.at(i) = child;
+    set_child_bbox(i, bbox);
+  }
+
+  void set_child_bbox(std::size_t i, const Bbox& bbox) {
+    for (auto axis = 0; axis < 3; ++axis) {
+      min_.at(axis).at(i) = internal::round_down_to_float(bbox.min(axis));
+      max_.at(axis).at(i) = internal::round_up_to_float(bbox.max(axis));
+    }
+  }
+
+  // Returns the bit mask of the children whose bounding boxes overlap bbox.
+  //
+  // As the boxes are rounded outward, the result is conservative: a child whose bounding box
+  // in double precision overlaps bbox is always included.
+  unsigned overlap_mask(const Bbox& bbox) const {
+    unsigned mask = (1U << num_children_) - 1;
+#ifdef KIGUMI_AABB_WIDE_NODE_SSE
+    for (auto axis = 0; axis < 3; ++axis) {
+      auto lo = _mm_set1_ps(internal::round_down_to_float(bbox.min(axis)));
+      auto hi = _mm_set1_ps(internal::round_up_to_float(bbox.max(axis)));
+      auto overlaps = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(min_.at(axis).data()), hi),
+                                 _mm_cmple_ps(lo, _mm_load_ps(max_.at(axis).data())));
+      mask &= static_cast<unsigned>(_mm_movemask_ps(overlaps));
+    }
+#else
+    for (auto axis = 0; axis < 3; ++axis) {
+      auto lo = internal::round_down_to_float(bbox.min(axis));
+      auto hi = internal::round_up_to_float(bbox.max(axis));
+      for (std::size_t i = 0; i < kMaxNumChildren; ++i) {
+        if (!(min_.at(axis).at(i) <= hi && lo <= max_.at(axis).at(i))) {
+          mask &= ~(1U << i);
+        }
+      }
+    }
+#endif
+    return mask;
+  }
+
+#ifdef KIGUMI_AABB_WIDE_NODE_SSE
+  // Returns the bit mask of the children whose bounding boxes the ray may intersect.
+  //
+  // The bounds of t are widened by a relative margin that exceeds the rounding errors of the
+  // single-precision arithmetic, and those that come out as NaN are ignored, so the result is
+  // conservative as long as |o| is small enough that (near - near_origin) does not overflow.
+  unsigned ray_mask(const Ray_slabs& ray) const {
+    constexpr auto kInf = std::numeric_limits<float>::infinity();
+    // 2^-20, which is eight times the unit roundoff.
+    constexpr auto kRelativeMargin = 1.0F / (1 << 20);
+    constexpr auto kAbsoluteMargin = std::numeric_limits<float>::min();
+
+    auto sign_mask = _mm_set1_ps(-0.0F);
+    auto widen = [&](__m128 t) {
+      return _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, t), _mm_set1_ps(kRelativeMargin)),
+                        _mm_set1_ps(kAbsoluteMargin));
+    };
+
+    unsigned mask = (1U << num_children_) - 1;
+    auto enter = _mm_setzero_ps();
+    auto leave = _mm_set1_ps(kInf);
+    for (auto axis = 0; axis < 3; ++axis) {
+      if (ray.is_parallel.at(axis)) {
+        auto lo = _mm_set1_ps(ray.origin_min.at(axis));
+        auto hi = _mm_set1_ps(ray.origin_max.at(axis));
+        auto overlaps = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(min_.at(axis).data()), hi),
+                                   _mm_cmple_ps(lo, _mm_load_ps(max_.at(axis).data())));
+        mask &= static_cast<unsigned>(_mm_movemask_ps(overlaps));
+      }
+      if (!ray.has_direction.at(axis)) {
+        continue;
+      }
+
+      const auto& near = ray.near_is_min.at(axis) ? min_.at(axis) : max_.at(axis);
+      const auto& far = ray.near_is_min.at(axis) ? max_.at(axis) : min_.at(axis);
+      auto inv_min = _mm_set1_ps(ray.inv_dir_min.at(axis));
+      auto inv_max = _mm_set1_ps(ray.inv_dir_max.at(axis));
+      auto near_x = _mm_sub_ps(_mm_load_ps(near.data()), _mm_set1_ps(ray.near_origin.at(axis)));
+      auto far_x = _mm_sub_ps(_mm_load_ps(far.data()), _mm_set1_ps(ray.far_origin.at(axis)));
+      auto t_near = _mm_min_ps(_mm_mul_ps(near_x, inv_min), _mm_mul_ps(near_x, inv_max));
+      auto t_far = _mm_max_ps(_mm_mul_ps(far_x, inv_min), _mm_mul_ps(far_x, inv_max));
+      t_near = _mm_sub_ps(t_near, widen(t_near));
+      t_far = _mm_add_ps(t_far, widen(t_far));
+
+      // _mm_max_ps and _mm_min_ps return the second operand if the first one is NaN.
+      enter = _mm_max_ps(t_near, enter);
+      leave = _mm_min_ps(t_far, leave);
+    }
+
+    return mask & static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(enter, leave)));
+  }
+#endif
+
+  static bool is_leaf(Child child) { return AABB_node::is_leaf(child); }
+
+  static std::size_t index(Child child) { return AABB_node::index(child); }
+
+  static std::size_t num_leaves(Child child) { return AABB_node::num_leaves(child); }
+
+ private:
+  std::array<std::array<float, kMaxNumChildren>, 3> min_{};
+  std::array<std::array<float, kMaxNumChildren>, 3> max_{};
+  std::array<Child, kMaxNumChildren> children_{};
+  std::size_t num_children_{};
+};
+
+static_assert(sizeof(AABB_wide_node) == 128);
+
+}  // namespace kigumi
@@ -3,12 +3,14 @@
 #include <kigumi/Boolean_operator.h>
 #include <kigumi/Extract.h>
 #include <kigumi/Face_tag.h>
+#include <kigumi/Mesh_indices.h>
 #include <kigumi/Mix.h>
 #include <kigumi/Mixed.h>
 #include <kigumi/Region.h>
 #include <kigumi/Warnings.h>
 
 #include <algorithm>
+#include <cstddef>
 #include <iterator>
 #include <stdexcept>
 #include <tuple>
@@ -72,7 +74,7 @@ class Boolean_region_builder {
       return;
     }
 
-    std::tie(m_, warnings_) = Mix{}(a.boundary_, b.boundary_);
+    std::tie(m_, warnings_, stats_) = Mix{}(a.boundary_, b.boundary_);
   }
 
   Region operator()(Boolean_operator op, bool prefer_first = true) const {
@@ -129,6 +131,29 @@ class Boolean_region_builder {
 
   Warnings warnings() const { return warnings_; }
 
+  // The number of the intersection points of the boundaries of the regions.
+  std::size_t num_intersection_points() const { return stats_.num_intersection_points; }
+
+  // The number of the intersection points that have been evaluated exactly so far. It is less
+  // than num_intersection_points() only if Corefine_options::lazy_intersection_points() is true.
+  //
+  // A lazy point caches its exact value when a filter on it fails, and the count is read from
+  // there on each call, so it costs nothing unless called.
+  std::size_t num_evaluated_intersection_points() const {
+    std::size_t count{};
+    for (auto id = m_.num_vertices() - stats_.num_intersection_points; id < m_.num_vertices();
+         ++id) {
+      count += !m_.point(Vertex_index{id}).ptr()->is_lazy();
+    }
+    return count;
+  }
+
+  // The total numbers of the orientations of the face pairs that are found in the caches of
+  // Face_face_intersection and are not, respectively.
+  std::size_t num_orientation_cache_hits() const { return stats_.num_orientation_cache_hits; }
+
+  std::size_t num_orientation_cache_misses() const { return stats_.num_orientation_cache_misses; }
+
  private:
   static bool apply(Boolean_operator op, bool a, bool b) {
     switch (op) {
@@ -173,6 +198,7 @@ class Boolean_region_builder {
   Region_kind second_kind_;
   Mixed_triangle_soup m_;
   Warnings warnings_{};
+  Mix_statistics stats_;
 };
 
 }  // namespace kigumi
@@ -1,20 +1,20 @@
 #pragma once
 
 #include <CGAL/enum.h>
+#include <kigumi/Concurrent_union_find.h>
 #include <kigumi/Face_tag.h>
 #include <kigumi/Mesh_entities.h>
 #include <kigumi/Mesh_indices.h>
 #include <kigumi/Mixed.h>
-#include <kigumi/Propagate_face_tags.h>
 #include <kigumi/Side_of_triangle_soup.h>
 #include <kigumi/Triangle_soup.h>
 #include <kigumi/Warnings.h>
 #include <kigumi/mesh_utility.h>
 #include <kigumi/parallel_do.h>
+#include <kigumi/parallel_sort.h>
 
-#include <queue>
+#include <limits>
 #include <stdexcept>
-#include <tuple>
 #include <vector>
 
 namespace kigumi {
@@ -22,21 +22,32 @@ namespace kigumi {
 template <class K, class FaceData>
 class Classify_faces_globally {
   using Mixed_triangle_mesh = Mixed_triangle_mesh<K, FaceData>;
-  using Propagate_face_tags = Propagate_face_tags<K, FaceData>;
   using Side_of_triangle_soup = Side_of_triangle_soup<K, FaceData>;
   using Triangle_soup = Triangle_soup<K, FaceData>;
 
  public:
   Warnings operator()(Mixed_triangle_mesh& m, const Edge_set& border_edges,
                       const Triangle_soup& left, const Triangle_soup& right) const {
-    auto representative_faces = find_unclassified_connected_components(m, border_edges);
-    Warnings warnings{};
+    auto components = label_unclassified_connected_components(m, border_edges);
+
+    std::vector<Face_index> representative_faces;
+    parallel_do(
+        m.faces_begin(), m.faces_end(), [] { return std::vector<Face_index>{}; },
+        [&](auto fi, auto& local_faces) {
+          if (components.at(fi.idx()) == fi.idx()) {
+            local_faces.push_back(fi);
+          }
+        },
+        [&](auto& local_faces) {
+          representative_faces.insert(representative_faces.end(), local_faces.begin(),
+                                      local_faces.end());
+        });
+    parallel_sort(representative_faces.begin(), representative_faces.end());
 
     parallel_do(
         representative_faces.begin(), representative_faces.end(),
-        [] { return std::make_tuple(Warnings{}, Propagate_face_tags{}, Side_of_triangle_soup{}); },
-        [&](auto fi_src, auto& local_state) {
-          auto& [local_warnings, propagate_face_tags, side_of_triangle_soup] = local_state;
+        [] { return Side_of_triangle_soup{}; },
+        [&](auto fi_src, auto& side_of_triangle_soup) {
           auto& f_src = m.data(fi_src);
           const auto& soup_trg = f_src.from_left ? right : left;
           auto p_src = internal::face_centroid(m, fi_src);
@@ -46,62 +57,71 @@ class Classify_faces_globally {
                 "local classification must be performed before global classification");
           }
           f_src.tag = side == CGAL::ON_POSITIVE_SIDE ? Face_tag::EXTERIOR : Face_tag::INTERIOR;
-          local_warnings |= propagate_face_tags(m, border_edges, fi_src);
         },
-        [&](auto& local_state) {
-          auto& [local_warnings, propagate_face_tags, side_of_triangle_soup] = local_state;
-          warnings |= local_warnings;
-        });
+        [](auto& /*side_of_triangle_soup*/) {}, 1);
 
-    return warnings;
-  }
+    // Assign the tag of the representative face to each face of the component, and check
+    // the consistency with the adjacent faces that have been classified locally.
+    Warnings warnings{};
+    parallel_do(
+        m.faces_begin(), m.faces_end(), [] { return Warnings{}; },
+        [&](auto fi, auto& local_warnings) {
+          auto component = components.at(fi.idx());
+          if (component == kNone) {
+            return;
+          }
 
- private:
-  static std::vector<Face_index> find_unclassified_connected_components(
-      const Mixed_triangle_mesh& m, const Edge_set& border_edges) {
-    std::vector<Face_index> representative_faces;
-    std::vector<bool> visited(m.num_faces(), false);
-    std::queue<Face_index> queue;
+          const auto& data_src = m.data(Face_index{component});
+          if (component != fi.idx()) {
+            m.data(fi).tag = data_src.tag;
+          }
 
-    auto begin = m.faces_begin();
-    auto end = m.faces_end();
+          for (auto adj_fi : m.faces_around_face(fi, border_edges)) {
+            if (components.at(adj_fi.idx()) != kNone || m.data(adj_fi).tag == data_src.tag) {
+              continue;
+            }
 
-    while (true) {
-      for (auto it = begin; it != end; ++it) {
-        auto fi = *it;
-        if (visited.at(fi.idx())) {
-          continue;
-        }
+            if (data_src.from_left) {
+              local_warnings |= Warnings::FIRST_MESH_PARTIALLY_INTERSECTS_WITH_SECOND_MESH;
+            } else {
+              local_warnings |= Warnings::SECOND_MESH_PARTIALLY_INTERSECTS_WITH_FIRST_MESH;
+            }
+          }
+        },
+        [&](auto& local_warnings) { warnings |= local_warnings; });
 
-        visited.at(fi.idx()) = true;
-        if (m.data(fi).tag == Face_tag::UNKNOWN) {
-          queue.push(fi);
-          representative_faces.push_back(fi);
-          begin = ++it;
-          break;
-        }
-      }
+    return warnings;
+  }
 
-      if (queue.empty()) {
-        break;
-      }
+ private:
+  static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
 
-      while (!queue.empty()) {
-        auto fi = queue.front();
-        queue.pop();
+  // Returns the component id of each face, which is the index of the smallest face in
+  // the component, or kNone if the face is already classified. The components are the connected
+  // components of the unclassified faces, where the faces are connected by non-border edges.
+  static std::vector<std::size_t> label_unclassified_connected_components(
+      const Mixed_triangle_mesh& m, const Edge_set& border_edges) {
+    Concurrent_union_find union_find{m.num_faces()};
 
-        for (auto adj_fi : m.faces_around_face(fi, border_edges)) {
-          if (visited.at(adj_fi.idx())) {
-            continue;
-          }
+    parallel_do(m.faces_begin(), m.faces_end(), [&](auto fi) {
+      if (m.data(fi).tag != Face_tag::UNKNOWN) {
+        return;
+      }
 
-          visited.at(adj_fi.idx()) = true;
-          queue.push(adj_fi);
+      for (auto adj_fi : m.faces_around_face(fi, border_edges)) {
+        if (adj_fi < fi && m.data(adj_fi).tag == Face_tag::UNKNOWN) {
+          union_find.unite(fi.idx(), adj_fi.idx());
         }
       }
-    }
+    });
+
+    std::vector<std::size_t> components(m.num_faces());
+    parallel_do(m.faces_begin(), m.faces_end(), [&](auto fi) {
+      components.at(fi.idx()) =
+          m.data(fi).tag == Face_tag::UNKNOWN ? union_find.find(fi.idx()) : kNone;
+    });
 
-    return representative_faces;
+    return components;
   }
 };
 
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace kigumi {
+
+// A union-find structure over the elements [0, size) that supports concurrent unite and find.
+//
+// A root is always linked to a root with a smaller index, so the root of a set is its smallest
+// element, regardless of the order in which the sets are united.
+class Concurrent_union_find {
+ public:
+  explicit Concurrent_union_find(std::size_t size) : parents_(size) {
+    for (std::size_t i = 0; i < size; ++i) {
+      parents_.at(i).store(i, std::memory_order_relaxed);
+    }
+  }
+
+  std::size_t find(std::size_t i) {
+    while (true) {
+      auto parent = parents_.at(i).load(std::memory_order_acquire);
+      if (parent == i) {
+        return i;
+      }
+
+      // Path halving.
+      auto grandparent = parents_.at(parent).load(std::memory_order_acquire);
+      if (grandparent != parent) {
+        parents_.at(i).compare_exchange_weak(parent, grandparent, std::memory_order_acq_rel);
+      }
+      i = grandparent;
+    }
+  }
+
+  void unite(std::size_t i, std::size_t j) {
+    while (true) {
+      i = find(i);
+      j = find(j);
+      if (i == j) {
+        return;
+      }
+
+      if (i < j) {
+        std::swap(i, j);
+      }
+
+      // Link the root i to j, unless i has been linked in the meantime.
+      auto expected = i;
+      if (parents_.at(i).compare_exchange_strong(expected, j, std::memory_order_acq_rel)) {
+        return;
+      }
+    }
+  }
+
+ private:
+  std::vector<std::atomic<std::size_t>> parents_;
+};
+
+}  // namespace kigumi
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <kigumi/Context.h>
 #include <kigumi/Face_face_intersection.h>
 #include <kigumi/Face_tag.h>
 #include <kigumi/Find_coplanar_faces.h>
@@ -8,26 +9,51 @@
 #include <kigumi/Mesh_entities.h>
 #include <kigumi/Mesh_indices.h>
 #include <kigumi/Point_list.h>
+#include <kigumi/Task_graph.h>
 #include <kigumi/Triangle_region.h>
 #include <kigumi/Triangle_soup.h>
 #include <kigumi/Triangulation.h>
 #include <kigumi/parallel_do.h>
+#include <kigumi/parallel_scan.h>
+#include <kigumi/parallel_sort.h>
 
 #include <algorithm>
+#include <atomic>
 #include <boost/container/static_vector.hpp>
 #include <boost/iterator/function_output_iterator.hpp>
-#include <boost/range/iterator_range.hpp>
 #include <boost/unordered/unordered_flat_map.hpp>
 #include <functional>
 #include <iostream>
+#include <numeric>
 #include <optional>
 #include <stdexcept>
 #include <tuple>
 #include <utility>
+#include <variant>
 #include <vector>
 
 namespace kigumi {
 
+class Corefine_options {
+ public:
+  // If true, the intersection points are kept as lazy kernel constructions, and each of them is
+  // evaluated exactly only when a predicate on it cannot be decided by its approximation.
+  // Otherwise, they are evaluated exactly as soon as they are constructed.
+  //
+  // Exact evaluation may then happen concurrently in the later stages, which requires CGAL to be
+  // built with thread support.
+  bool lazy_intersection_points() const { return lazy_intersection_points_; }
+
+  void set_lazy_intersection_points(bool lazy_intersection_points) {
+    lazy_intersection_points_ = lazy_intersection_points;
+  }
+
+ private:
+  bool lazy_intersection_points_{};
+};
+
+using Corefine_context = Context<Corefine_options>;
+
 template <class K, class FaceData>
 class Corefine {
   using Face_face_intersection = Face_face_intersection<K>;
@@ -40,36 +66,182 @@ class Corefine {
   using Triangulation = Triangulation<K>;
 
  public:
-  Corefine(const Triangle_soup& left, const Triangle_soup& right) : left_{left}, right_{right} {
+  Corefine(const Triangle_soup& left, const Triangle_soup& right)
+      : left_{left},
+        right_{right},
+        lazy_intersection_points_{Corefine_context::current().lazy_intersection_points()} {
     std::cout << "Finding face pairs..." << std::endl;
 
-    points_.start_uniqueness_check();
-    points_.reserve(left_.num_vertices() + right_.num_vertices());
-    for (auto vi : left_.vertices()) {
-      left_point_ids_.push_back(points_.insert(left_.point(vi)));
-    }
-    for (auto vi : right_.vertices()) {
-      right_point_ids_.push_back(points_.insert(right_.point(vi)));
+    // The stages run as a task graph. The AABB trees are built while the points are deduplicated
+    // and the coplanar faces are found.
+    Task_graph graph;
+    std::vector<std::pair<Face_index, Face_index>> pairs;
+
+    auto build_left_tree = graph.add([&] { left_.aabb_tree(); });
+    auto build_right_tree = graph.add([&] { right_.aabb_tree(); });
+    auto insert_points = graph.add([&] {
+      auto num_left_points = left_.num_vertices();
+      auto ids = points_.insert_unique(
+          num_left_points + right_.num_vertices(), [&](std::size_t i) -> const Point& {
+            return i < num_left_points ? left_.point(Vertex_index{i})
+                                       : right_.point(Vertex_index{i - num_left_points});
+          });
+      left_point_ids_.assign(ids.begin(), ids.begin() + num_left_points);
+      right_point_ids_.assign(ids.begin() + num_left_points, ids.end());
+    });
+    auto find_coplanar_faces = graph.add(
+        [&] {
+          std::tie(left_face_tags_, right_face_tags_) =
+              Find_coplanar_faces{}(left_, right_, left_point_ids_, right_point_ids_);
+        },
+        {insert_points});
+    auto find_pairs = graph.add(
+        [&] {
+          pairs = Find_possibly_intersecting_faces{}(left_, right_, left_face_tags_,
+                                                     right_face_tags_);
+        },
+        {build_left_tree, build_right_tree, find_coplanar_faces});
+    graph.add([&] { intersect(pairs); }, {find_pairs});
+    graph.run();
+  }
+
+  Edge_set get_intersecting_edges() const {
+    Edge_set edges;
+
+    for (const auto& info : infos_) {
+      auto n = info.intersections.size();
+      if (n < 2) {
+        continue;
+      }
+
+      for (std::size_t i = 0; i < n; ++i) {
+        auto j = i < n - 1 ? i + 1 : 0;
+        auto a = info.intersections.at(i);
+        auto b = info.intersections.at(j);
+        edges.insert(make_edge(Vertex_index{a}, Vertex_index{b}));
+      }
     }
-    points_.stop_uniqueness_check();
 
-    std::tie(left_face_tags_, right_face_tags_) =
-        Find_coplanar_faces{}(left_, right_, left_point_ids_, right_point_ids_);
+    return edges;
+  }
+
+  template <class OutputIterator>
+  std::pair<Face_tag, std::size_t> get_left_faces(Face_index fi, OutputIterator faces) const {
+    auto tag = left_face_tags_.at(fi.idx());
+    auto count = get_faces(left_, fi, left_triangulations_, left_point_ids_, faces);
+    return {tag, count};
+  }
+
+  template <class OutputIterator>
+  std::pair<Face_tag, std::size_t> get_right_faces(Face_index fi, OutputIterator faces) const {
+    auto tag = right_face_tags_.at(fi.idx());
+    auto count = get_faces(right_, fi, right_triangulations_, right_point_ids_, faces);
+    return {tag, count};
+  }
+
+  std::vector<Point> take_points() { return points_.take_points(); }
+
+  // The intersection points have the ids [first_intersection_point_id(), the number of points).
+  std::size_t first_intersection_point_id() const { return first_intersection_point_id_; }
+
+  // The total numbers of the orientations of the face pairs that are found in the caches of
+  // Face_face_intersection and are not, respectively.
+  std::size_t num_orientation_cache_hits() const { return num_orientation_cache_hits_; }
+
+  std::size_t num_orientation_cache_misses() const { return num_orientation_cache_misses_; }
+
+ private:
+  struct Intersection_info {
+    Face_index left_fi;
+    Face_index right_fi;
+    boost::container::static_vector<Triangle_region, 6> symbolic_intersections;
+    boost::container::static_vector<std::size_t, 6> intersections;
+  };
+
+  // {face, index into infos_} pairs sorted by face.
+  using Info_index = std::vector<std::pair<Face_index, std::size_t>>;
+
+  // Triangulates a face with the intersections infos_.at(index.at(k).second) for k in [begin, end).
+  struct Triangulation_task {
+    bool from_left;
+    std::size_t begin;
+    std::size_t end;
+  };
+
+  // As infos_ is sorted by the left face, the index is in the same order.
+  Info_index index_infos_by_left_face() const {
+    Info_index index(infos_.size());
+    std::vector<std::size_t> info_indices(infos_.size());
+    std::iota(info_indices.begin(), info_indices.end(), std::size_t{0});
+    parallel_do(info_indices.begin(), info_indices.end(),
+                [&](std::size_t i) { index.at(i) = {infos_.at(i).left_fi, i}; });
+    return index;
+  }
+
+  // Sorts infos_ by the right face with a counting sort.
+  Info_index index_infos_by_right_face() const {
+    auto num_faces = right_.num_faces();
+
+    // The number of infos with each right face, and then the next free slot in the index.
+    std::vector<std::atomic<std::size_t>> cursors(num_faces);
+    parallel_do(infos_.begin(), infos_.end(), [&](const Intersection_info& info) {
+      cursors.at(info.right_fi.idx()).fetch_add(1, std::memory_order_relaxed);
+    });
+
+    std::vector<std::size_t> offsets(num_faces + 1);
+    offsets.back() =
+        parallel_exclusive_scan(cursors.begin(), cursors.end(), offsets.begin(), std::size_t{0});
+    parallel_do(right_.faces_begin(), right_.faces_end(), [&](Face_index fi) {
+      cursors.at(fi.idx()).store(offsets.at(fi.idx()), std::memory_order_relaxed);
+    });
+
+    Info_index index(infos_.size());
+    std::vector<std::size_t> info_indices(infos_.size());
+    std::iota(info_indices.begin(), info_indices.end(), std::size_t{0});
+    parallel_do(info_indices.begin(), info_indices.end(), [&](std::size_t i) {
+      auto fi = infos_.at(i).right_fi;
+      auto slot = cursors.at(fi.idx()).fetch_add(1, std::memory_order_relaxed);
+      index.at(slot) = {fi, i};
+    });
+
+    // The infos of each face are put back in the order of infos_, so that the triangulations do
+    // not depend on the scheduling.
+    parallel_do(right_.faces_begin(), right_.faces_end(), [&](Face_index fi) {
+      std::sort(index.begin() + offsets.at(fi.idx()), index.begin() + offsets.at(fi.idx() + 1));
+    });
+    return index;
+  }
 
-    auto pairs =
-        Find_possibly_intersecting_faces{}(left_, right_, left_face_tags_, right_face_tags_);
+  static void add_triangulation_tasks(
+      bool from_left, const Info_index& index,
+      boost::unordered_flat_map<Face_index, std::optional<Triangulation>, std::hash<Face_index>>&
+          triangulations,
+      std::vector<Triangulation_task>& tasks) {
+    for (std::size_t begin = 0; begin < index.size();) {
+      auto fi = index.at(begin).first;
+      auto end = begin + 1;
+      while (end < index.size() && index.at(end).first == fi) {
+        ++end;
+      }
+      triangulations.emplace(fi, std::nullopt);
+      tasks.push_back({from_left, begin, end});
+      begin = end;
+    }
+  }
 
+  // Computes the intersections of the face pairs and triangulates the intersected faces.
+  void intersect(const std::vector<std::pair<Face_index, Face_index>>& pairs) {
     std::cout << "Finding symbolic intersections..." << std::endl;
 
-    std::size_t num_intersections{};
+    // The pairs are sorted by the left face, so that each thread processes the pairs sharing
+    // the left face in succession, and the orientation caches hit.
     parallel_do(
         pairs.begin(), pairs.end(),
         [&] {
-          return std::make_tuple(std::vector<Intersection_info>{}, std::size_t{},
-                                 Face_face_intersection{points_});
+          return std::make_tuple(std::vector<Intersection_info>{}, Face_face_intersection{points_});
         },
         [&](const auto& pair, auto& local_state) {
-          auto& [local_infos, local_num_intersections, face_face_intersection] = local_state;
+          auto& [local_infos, face_face_intersection] = local_state;
           auto [left_fi, right_fi] = pair;
           const auto& left_face = left_.face(left_fi);
           const auto& right_face = right_.face(right_fi);
@@ -84,167 +256,166 @@ class Corefine {
             return;
           }
           local_infos.emplace_back(left_fi, right_fi, sym_inters);
-          local_num_intersections += sym_inters.size();
         },
         [&](auto& local_state) {
-          auto& [local_infos, local_num_intersections, face_face_intersection] = local_state;
+          auto& [local_infos, face_face_intersection] = local_state;
           if (infos_.empty()) {
             infos_ = std::move(local_infos);
           } else {
             infos_.insert(infos_.end(), local_infos.begin(), local_infos.end());
           }
-          num_intersections += local_num_intersections;
+          num_orientation_cache_hits_ += face_face_intersection.num_cache_hits();
+          num_orientation_cache_misses_ += face_face_intersection.num_cache_misses();
         });
 
-    std::cout << "Constructing intersection points..." << std::endl;
+    // Sort the infos so that the ids of the intersection points do not depend on the scheduling.
+    parallel_sort(infos_.begin(), infos_.end(),
+                  [](const Intersection_info& a, const Intersection_info& b) -> bool {
+                    return std::tie(a.left_fi, a.right_fi) < std::tie(b.left_fi, b.right_fi);
+                  });
 
-    auto num_points_before_insertion = points_.size();
-
-    points_.reserve(num_points_before_insertion + num_intersections / 2);
-    Intersection_point_inserter inserter(points_);
-    for (auto& info : infos_) {
-      const auto& left_face = left_.face(info.left_fi);
-      const auto& right_face = right_.face(info.right_fi);
-      auto a = left_point_ids_.at(left_face[0].idx());
-      auto b = left_point_ids_.at(left_face[1].idx());
-      auto c = left_point_ids_.at(left_face[2].idx());
-      auto p = right_point_ids_.at(right_face[0].idx());
-      auto q = right_point_ids_.at(right_face[1].idx());
-      auto r = right_point_ids_.at(right_face[2].idx());
-      for (auto sym_inter : info.symbolic_intersections) {
-        auto left_region = intersection(sym_inter, Triangle_region::LEFT_FACE);
-        auto right_region = intersection(sym_inter, Triangle_region::RIGHT_FACE);
-        auto id = inserter.insert(left_region, a, b, c, right_region, p, q, r);
-        info.intersections.push_back(id);
-      }
-    }
+    std::cout << "Constructing intersection points..." << std::endl;
 
-    parallel_do(points_.begin() + num_points_before_insertion, points_.end(),
-                [](const auto& p) { p.exact(); });
+    construct_intersection_points();
 
     std::cout << "Triangulating..." << std::endl;
 
-    auto left_fi_less = [](const Intersection_info& a, const Intersection_info& b) -> bool {
-      return a.left_fi < b.left_fi;
-    };
-    std::sort(infos_.begin(), infos_.end(), left_fi_less);
-
-    std::vector<boost::iterator_range<typename decltype(infos_)::const_iterator>> ranges;
-    for (auto first = infos_.begin(); first != infos_.end();) {
-      auto last = std::upper_bound(first + 1, infos_.end(), *first, left_fi_less);
-      ranges.emplace_back(first, last);
-      first = last;
-    }
+    auto left_index = index_infos_by_left_face();
+    auto right_index = index_infos_by_right_face();
+
+    // The faces of both sides are triangulated in a single task set so that the tail of one side
+    // overlaps with the other.
+    std::vector<Triangulation_task> tasks;
+    add_triangulation_tasks(true, left_index, left_triangulations_, tasks);
+    add_triangulation_tasks(false, right_index, right_triangulations_, tasks);
+
+    parallel_do_by_cost(
+        tasks.begin(), tasks.end(), [](const auto& task) { return task.end - task.begin; },
+        [&](const auto& task) {
+          const auto& soup = task.from_left ? left_ : right_;
+          const auto& point_ids = task.from_left ? left_point_ids_ : right_point_ids_;
+          auto& triangulations = task.from_left ? left_triangulations_ : right_triangulations_;
+          const auto& index = task.from_left ? left_index : right_index;
+          auto region = task.from_left ? Triangle_region::LEFT_FACE : Triangle_region::RIGHT_FACE;
+
+          auto fi = index.at(task.begin).first;
+          const auto& f = soup.face(fi);
+          auto a = point_ids.at(f[0].idx());
+          auto b = point_ids.at(f[1].idx());
+          auto c = point_ids.at(f[2].idx());
+
+          try {
+            auto& triangulation = triangulations.at(fi).emplace(points_, region, a, b, c);
+            for (auto k = task.begin; k < task.end; ++k) {
+              insert_intersection(triangulation, infos_.at(index.at(k).second));
+            }
+          } catch (const typename Triangulation::Intersection_of_constraints_exception&) {
+            throw std::runtime_error(task.from_left ? "the second mesh has self-intersections"
+                                                    : "the first mesh has self-intersections");
+          }
+        });
+  }
 
-    left_triangulations_.reserve(ranges.size());
-    for (const auto& range : ranges) {
-      const auto& any_info = range.front();
-      auto fi = any_info.left_fi;
-      left_triangulations_.emplace(fi, std::nullopt);
+  // Constructs the intersection points and assigns their ids to info.intersections.
+  //
+  // The canonical keys of the points are computed in parallel and deduplicated by sorting.
+  // The new points are numbered in the order of their first appearance in infos_,
+  // which reproduces the ids assigned by a serial Intersection_point_inserter.
+  void construct_intersection_points() {
+    using Key = typename Intersection_point_inserter::Key;
+
+    // The intersections of infos_.at(i) are at [offsets.at(i), offsets.at(i + 1))
+    // in the flattened list of intersections.
+    std::vector<std::size_t> offsets;
+    offsets.reserve(infos_.size() + 1);
+    offsets.push_back(0);
+    for (const auto& info : infos_) {
+      offsets.push_back(offsets.back() + info.symbolic_intersections.size());
     }
 
-    try {
-      parallel_do(ranges.begin(), ranges.end(), [&](const auto& range) {
-        const auto& any_info = range.front();
-        auto fi = any_info.left_fi;
-        const auto& f = left_.face(fi);
-        auto a = left_point_ids_.at(f[0].idx());
-        auto b = left_point_ids_.at(f[1].idx());
-        auto c = left_point_ids_.at(f[2].idx());
-
-        auto& triangulation =
-            left_triangulations_.at(fi).emplace(points_, Triangle_region::LEFT_FACE, a, b, c);
-        for (const auto& info : range) {
-          insert_intersection(triangulation, info);
-        }
-      });
-    } catch (const typename Triangulation::Intersection_of_constraints_exception&) {
-      throw std::runtime_error("the second mesh has self-intersections");
-    }
+    std::vector<std::size_t> ids(offsets.back());
+    // The keys of the points to be constructed, paired with their positions in the flattened list.
+    std::vector<std::pair<Key, std::size_t>> keys;
 
-    auto right_fi_less = [](const Intersection_info& a, const Intersection_info& b) -> bool {
-      return a.right_fi < b.right_fi;
-    };
-    std::sort(infos_.begin(), infos_.end(), right_fi_less);
+    std::vector<std::size_t> info_indices(infos_.size());
+    std::iota(info_indices.begin(), info_indices.end(), std::size_t{0});
+    parallel_do(
+        info_indices.begin(), info_indices.end(),
+        [] { return std::vector<std::pair<Key, std::size_t>>{}; },
+        [&](std::size_t i, auto& local_keys) {
+          const auto& info = infos_.at(i);
+          const auto& left_face = left_.face(info.left_fi);
+          const auto& right_face = right_.face(info.right_fi);
+          auto a = left_point_ids_.at(left_face[0].idx());
+          auto b = left_point_ids_.at(left_face[1].idx());
+          auto c = left_point_ids_.at(left_face[2].idx());
+          auto p = right_point_ids_.at(right_face[0].idx());
+          auto q = right_point_ids_.at(right_face[1].idx());
+          auto r = right_point_ids_.at(right_face[2].idx());
+          auto pos = offsets.at(i);
+          for (auto sym_inter : info.symbolic_intersections) {
+            auto left_region = intersection(sym_inter, Triangle_region::LEFT_FACE);
+            auto right_region = intersection(sym_inter, Triangle_region::RIGHT_FACE);
+            auto id_or_key =
+                Intersection_point_inserter::resolve(left_region, a, b, c, right_region, p, q, r);
+            if (const auto* id = std::get_if<std::size_t>(&id_or_key)) {
+              ids.at(pos) = *id;
+            } else {
+              local_keys.emplace_back(std::get<Key>(id_or_key), pos);
+            }
+            ++pos;
+          }
+        },
+        [&](auto& local_keys) { keys.insert(keys.end(), local_keys.begin(), local_keys.end()); });
 
-    ranges.clear();
-    for (auto first = infos_.begin(); first != infos_.end();) {
-      auto last = std::upper_bound(first + 1, infos_.end(), *first, right_fi_less);
-      ranges.emplace_back(first, last);
-      first = last;
-    }
+    parallel_sort(keys.begin(), keys.end());
 
-    right_triangulations_.reserve(ranges.size());
-    for (const auto& range : ranges) {
-      const auto& any_info = range.front();
-      auto fi = any_info.right_fi;
-      right_triangulations_.emplace(fi, std::nullopt);
+    // Each run of equal keys defines a distinct point. The first element of a run has
+    // the smallest position, which is also stored in first_positions for the whole run.
+    std::vector<std::pair<std::size_t, std::size_t>> runs;  // {first position, index in keys}
+    std::vector<std::size_t> first_positions(keys.size());
+    for (std::size_t k = 0; k < keys.size(); ++k) {
+      if (k == 0 || keys.at(k).first != keys.at(k - 1).first) {
+        runs.emplace_back(keys.at(k).second, k);
+      }
+      first_positions.at(k) = runs.back().first;
     }
+    parallel_sort(runs.begin(), runs.end());
 
-    try {
-      parallel_do(ranges.begin(), ranges.end(), [&](const auto& range) {
-        const auto& any_info = range.front();
-        auto fi = any_info.right_fi;
-        const auto& f = right_.face(fi);
-        auto a = right_point_ids_.at(f[0].idx());
-        auto b = right_point_ids_.at(f[1].idx());
-        auto c = right_point_ids_.at(f[2].idx());
-
-        auto& triangulation = right_triangulations_.at(any_info.right_fi)
-                                  .emplace(points_, Triangle_region::RIGHT_FACE, a, b, c);
-        for (const auto& info : range) {
-          insert_intersection(triangulation, info);
-        }
-      });
-    } catch (const typename Triangulation::Intersection_of_constraints_exception&) {
-      throw std::runtime_error("the first mesh has self-intersections");
-    }
-  }
+    std::vector<Point> new_points(runs.size());
+    std::vector<std::size_t> ranks(runs.size());
+    std::iota(ranks.begin(), ranks.end(), std::size_t{0});
+    parallel_do(ranks.begin(), ranks.end(), [&](std::size_t rank) {
+      const auto& key = keys.at(runs.at(rank).second).first;
+      new_points.at(rank) = Intersection_point_inserter::construct(points_, key);
+    });
 
-  Edge_set get_intersecting_edges() const {
-    Edge_set edges;
+    auto first_id = points_.append(std::move(new_points));
+    first_intersection_point_id_ = first_id;
 
-    for (const auto& info : infos_) {
-      auto n = info.intersections.size();
-      if (n < 2) {
-        continue;
-      }
-
-      for (std::size_t i = 0; i < n; ++i) {
-        auto j = i < n - 1 ? i + 1 : 0;
-        auto a = info.intersections.at(i);
-        auto b = info.intersections.at(j);
-        edges.insert(make_edge(Vertex_index{a}, Vertex_index{b}));
-      }
+    if (!lazy_intersection_points_) {
+      parallel_do(points_.begin() + first_id, points_.end(), [](const auto& p) { p.exact(); });
     }
 
-    return edges;
-  }
+    parallel_do(ranks.begin(), ranks.end(),
+                [&](std::size_t rank) { ids.at(runs.at(rank).first) = first_id + rank; });
 
-  template <class OutputIterator>
-  std::pair<Face_tag, std::size_t> get_left_faces(Face_index fi, OutputIterator faces) const {
-    auto tag = left_face_tags_.at(fi.idx());
-    auto count = get_faces(left_, fi, left_triangulations_, left_point_ids_, faces);
-    return {tag, count};
-  }
+    std::vector<std::size_t> key_indices(keys.size());
+    std::iota(key_indices.begin(), key_indices.end(), std::size_t{0});
+    parallel_do(key_indices.begin(), key_indices.end(), [&](std::size_t k) {
+      auto pos = keys.at(k).second;
+      auto first_pos = first_positions.at(k);
+      if (pos != first_pos) {
+        ids.at(pos) = ids.at(first_pos);
+      }
+    });
 
-  template <class OutputIterator>
-  std::pair<Face_tag, std::size_t> get_right_faces(Face_index fi, OutputIterator faces) const {
-    auto tag = right_face_tags_.at(fi.idx());
-    auto count = get_faces(right_, fi, right_triangulations_, right_point_ids_, faces);
-    return {tag, count};
+    parallel_do(info_indices.begin(), info_indices.end(), [&](std::size_t i) {
+      auto& info = infos_.at(i);
+      info.intersections.assign(ids.begin() + offsets.at(i), ids.begin() + offsets.at(i + 1));
+    });
   }
 
-  std::vector<Point> take_points() { return points_.take_points(); }
-
- private:
-  struct Intersection_info {
-    Face_index left_fi;
-    Face_index right_fi;
-    boost::container::static_vector<Triangle_region, 6> symbolic_intersections;
-    boost::container::static_vector<std::size_t, 6> intersections;
-  };
-
   template <class OutputIterator>
   std::size_t get_faces(const Triangle_soup& soup, Face_index fi,
                         const boost::unordered_flat_map<Face_index, std::optional<Triangulation>,
@@ -299,6 +470,10 @@ class Corefine {
   std::vector<Face_tag> left_face_tags_;
   std::vector<Face_tag> right_face_tags_;
   std::vector<Intersection_info> infos_;
+  bool lazy_intersection_points_;
+  std::size_t first_intersection_point_id_{};
+  std::size_t num_orientation_cache_hits_{};
+  std::size_t num_orientation_cache_misses_{};
 };
 
 }  // namespace kigumi
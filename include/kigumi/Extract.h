@@ -5,7 +5,13 @@
 #include <kigumi/Mesh_indices.h>
 #include <kigumi/Mixed.h>
 #include <kigumi/Triangle_soup.h>
+#include <kigumi/parallel_do.h>
+#include <kigumi/parallel_scan.h>
 
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <numeric>
 #include <utility>
 #include <vector>
 
@@ -14,20 +20,23 @@ namespace kigumi {
 template <class K, class FaceData>
 class Extract {
   using Mixed_triangle_soup = Mixed_triangle_soup<K, FaceData>;
+  using Point = typename K::Point_3;
   using Triangle_soup = Triangle_soup<K, FaceData>;
 
  public:
+  // The output is the same as adding the output faces, and their vertices on first occurrence,
+  // one by one to a new soup, but it is computed in parallel with prefix-sum compaction.
   Triangle_soup operator()(const Mixed_triangle_soup& m, Boolean_operator op,
                            bool prefer_first) const {
-    Triangle_soup soup;
-    std::vector<Vertex_index> map(m.num_vertices());
-
     auto e_mask = exterior_mask(op);
     auto i_mask = interior_mask(op);
     auto c_mask = coplanar_mask(op, prefer_first);
     auto o_mask = opposite_mask(op, prefer_first);
 
-    for (auto fi : m.faces()) {
+    std::vector<Output> outputs(m.num_faces());
+    // 1 if the face is output, and then its index in the new soup.
+    std::vector<std::size_t> new_fis(m.num_faces());
+    parallel_do(m.faces_begin(), m.faces_end(), [&](auto fi) {
       auto mask = Mask::NONE;
       switch (m.data(fi).tag) {
         case Face_tag::EXTERIOR:
@@ -51,32 +60,85 @@ class Extract {
                                  : (mask & Mask::B) != Mask::NONE;
       auto output_inv = from_left ? (mask & Mask::A_INV) != Mask::NONE  //
                                   : (mask & Mask::B_INV) != Mask::NONE;
-      if (!output_id && !output_inv) {
-        continue;
+      auto output = output_inv  ? Output::INVERTED
+                    : output_id ? Output::AS_IS
+                                : Output::NONE;
+      outputs.at(fi.idx()) = output;
+      new_fis.at(fi.idx()) = output != Output::NONE ? 1 : 0;
+    });
+    auto num_new_faces =
+        parallel_exclusive_scan(new_fis.begin(), new_fis.end(), new_fis.begin(), std::size_t{0});
+
+    std::vector<Face_index> output_fis(num_new_faces);
+    parallel_do(m.faces_begin(), m.faces_end(), [&](auto fi) {
+      if (outputs.at(fi.idx()) != Output::NONE) {
+        output_fis.at(new_fis.at(fi.idx())) = fi;
+      }
+    });
+
+    // The vertex at position 3 * k + i is the i-th vertex of output_fis.at(k).
+    auto num_positions = 3 * num_new_faces;
+    std::vector<std::size_t> positions(num_positions);
+    std::iota(positions.begin(), positions.end(), std::size_t{0});
+    auto vertex_at = [&](std::size_t pos) { return m.face(output_fis.at(pos / 3)).at(pos % 3); };
+
+    // The first position at which each vertex occurs.
+    std::vector<std::atomic<std::size_t>> first_positions(m.num_vertices());
+    parallel_do(m.vertices_begin(), m.vertices_end(), [&](auto vi) {
+      first_positions.at(vi.idx()).store(kNone, std::memory_order_relaxed);
+    });
+    parallel_do(positions.begin(), positions.end(), [&](std::size_t pos) {
+      auto& first_pos = first_positions.at(vertex_at(pos).idx());
+      auto cur = first_pos.load(std::memory_order_relaxed);
+      while (pos < cur && !first_pos.compare_exchange_weak(cur, pos, std::memory_order_relaxed)) {
       }
+    });
+    auto is_first = [&](std::size_t pos) {
+      return first_positions.at(vertex_at(pos).idx()).load(std::memory_order_relaxed) == pos;
+    };
 
-      const auto& f = m.face(fi);
-      Face new_f;
+    // 1 if the vertex occurs first at the position, and then its index in the new soup.
+    std::vector<std::size_t> new_vis(num_positions);
+    parallel_do(positions.begin(), positions.end(),
+                [&](std::size_t pos) { new_vis.at(pos) = is_first(pos) ? 1 : 0; });
+    auto num_new_vertices =
+        parallel_exclusive_scan(new_vis.begin(), new_vis.end(), new_vis.begin(), std::size_t{0});
+
+    std::vector<Point> points(num_new_vertices);
+    parallel_do(positions.begin(), positions.end(), [&](std::size_t pos) {
+      if (is_first(pos)) {
+        points.at(new_vis.at(pos)) = m.point(vertex_at(pos));
+      }
+    });
+
+    std::vector<Face> faces(num_new_faces);
+    std::vector<FaceData> face_data(num_new_faces);
+    parallel_do(output_fis.begin(), output_fis.end(), [&](auto fi) {
+      auto new_fi = new_fis.at(fi.idx());
+      auto& new_f = faces.at(new_fi);
       for (std::size_t i = 0; i < 3; ++i) {
-        auto vi = f.at(i);
-        auto& new_vi = map.at(vi.idx());
-        if (new_vi == Vertex_index{}) {
-          const auto& p = m.point(vi);
-          new_vi = soup.add_vertex(p);
-        }
-        new_f.at(i) = new_vi;
+        auto first_pos = first_positions.at(m.face(fi).at(i).idx()).load(std::memory_order_relaxed);
+        new_f.at(i) = Vertex_index{new_vis.at(first_pos)};
       }
 
-      if (output_inv) {
+      if (outputs.at(fi.idx()) == Output::INVERTED) {
         std::swap(new_f[1], new_f[2]);
       }
 
-      auto new_fi = soup.add_face(new_f);
-      soup.data(new_fi) = m.data(fi).data;
-    }
+      face_data.at(new_fi) = m.data(fi).data;
+    });
 
-    return soup;
+    return {std::move(points), std::move(faces), std::move(face_data)};
   }
+
+ private:
+  enum class Output : std::uint8_t {
+    NONE,
+    AS_IS,
+    INVERTED,
+  };
+
+  static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
 };
 
 }  // namespace kigumi
@@ -4,34 +4,51 @@
 #include <CGAL/enum.h>
 #include <kigumi/Point_list.h>
 #include <kigumi/Triangle_region.h>
+#include <kigumi/static_filters.h>
 
 #include <algorithm>
 #include <array>
 #include <boost/container/static_vector.hpp>
 #include <boost/container_hash/hash.hpp>
-#include <boost/unordered/unordered_flat_map.hpp>
 #include <utility>
 #include <vector>
 
 namespace kigumi {
 
+// Computes the symbolic intersection of two faces.
+//
+// The 3D orientations are memoized in a bounded, direct-mapped cache that persists across calls,
+// as the face pairs processed in succession share many of their vertices. Therefore, the points
+// in the list must not be modified during the lifetime of an object, while new points can be
+// inserted. Each thread should own an object.
 template <class K>
 class Face_face_intersection {
   using Orientation_3_key = std::array<std::size_t, 4>;
   using Orientation_3_key_hash = boost::hash<Orientation_3_key>;
-  using Orientation_3_map =
-      boost::unordered_flat_map<Orientation_3_key, CGAL::Orientation, Orientation_3_key_hash>;
   using Point_list = Point_list<K>;
 
+  struct Orientation_3_entry {
+    // The sorted ids of the points. Empty entries have all ids zero, for which the orientation
+    // is also zero.
+    Orientation_3_key key{};
+    CGAL::Orientation orientation{CGAL::ZERO};
+  };
+
  public:
-  explicit Face_face_intersection(const Point_list& points) : points_(points) {}
+  explicit Face_face_intersection(const Point_list& points)
+      : points_(points), orientation_3_cache_(kOrientation3CacheSize) {}
+
+  // The numbers of the lookups of the 3D orientations that are not decided by the static filter,
+  // which are found in the cache and are not, respectively.
+  std::size_t num_cache_hits() const { return num_cache_hits_; }
+
+  std::size_t num_cache_misses() const { return num_cache_misses_; }
 
   boost::container::static_vector<Triangle_region, 6> operator()(std::size_t a, std::size_t b,
                                                                  std::size_t c, std::size_t p,
                                                                  std::size_t q,
                                                                  std::size_t r) const {
     intersections_.clear();
-    orientation_3_cache_.clear();
 
     auto fabc = Triangle_region::LEFT_FACE;
     auto fpqr = Triangle_region::RIGHT_FACE;
@@ -316,21 +333,30 @@ class Face_face_intersection {
   }
 
   CGAL::Orientation orientation(std::size_t a, std::size_t b, std::size_t c, std::size_t d) const {
+    // Most of the orientations of the input vertices are decided without the cache.
+    if (auto o = internal::static_filtered_orientation(points_.at(a), points_.at(b),
+                                                        points_.at(c), points_.at(d))) {
+      return *o;
+    }
+
     Orientation_3_key key{a, b, c, d};
     auto parity = sort(key);
-    auto [it, inserted] = orientation_3_cache_.emplace(key, CGAL::ZERO);
+    auto& entry =
+        orientation_3_cache_.at(Orientation_3_key_hash{}(key) & (kOrientation3CacheSize - 1));
 
-    if (inserted) {
+    if (entry.key == key) {
+      ++num_cache_hits_;
+    } else {
+      ++num_cache_misses_;
       const auto& pa = points_.at(key[0]);
       const auto& pb = points_.at(key[1]);
       const auto& pc = points_.at(key[2]);
       const auto& pd = points_.at(key[3]);
 
-      auto o = CGAL::orientation(pa, pb, pc, pd);
-      it->second = o;
+      entry = {key, CGAL::orientation(pa, pb, pc, pd)};
     }
 
-    return parity * it->second;
+    return parity * entry.orientation;
   }
 
   void insert(Triangle_region first, Triangle_region second) const {
@@ -341,9 +367,14 @@ class Face_face_intersection {
     intersections_.emplace_back(first, second);
   }
 
+  // A power of two. The cache takes 160 KiB on 64-bit platforms.
+  static constexpr std::size_t kOrientation3CacheSize = 4096;
+
   const Point_list& points_;
   mutable std::vector<std::pair<Triangle_region, Triangle_region>> intersections_;
-  mutable Orientation_3_map orientation_3_cache_;
+  mutable std::vector<Orientation_3_entry> orientation_3_cache_;
+  mutable std::size_t num_cache_hits_{};
+  mutable std::size_t num_cache_misses_{};
 };
 
 }  // namespace kigumi
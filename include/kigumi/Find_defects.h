@@ -6,7 +6,6 @@
 #include <kigumi/Mesh_indices.h>
 #include <kigumi/Point_list.h>
 #include <kigumi/Triangle_soup.h>
-#include <kigumi/mesh_utility.h>
 #include <kigumi/parallel_do.h>
 
 #include <algorithm>
@@ -24,6 +23,7 @@ namespace kigumi {
 
 template <class K, class FaceData>
 class Find_defects {
+  using Point = typename K::Point_3;
   using Point_list = Point_list<K>;
   using Triangle_soup = Triangle_soup<K, FaceData>;
   using Leaf = typename Triangle_soup::Leaf;
@@ -71,30 +71,18 @@ class Find_defects {
 
  private:
   static Triangle_soup merge_duplicate_vertices(const Triangle_soup& m) {
-    Triangle_soup new_m;
-
-    std::vector<Vertex_index> vi_map;
-    vi_map.reserve(m.num_vertices());
-
     Point_list points;
-    points.start_uniqueness_check();
-    for (auto vi : m.vertices()) {
-      const auto& p = m.point(vi);
-      auto next_idx = points.size();
-      auto idx = points.insert(p);
-      vi_map.push_back(Vertex_index{idx});
-      if (idx == next_idx) {
-        new_m.add_vertex(p);
-      }
-    }
+    auto ids = points.insert_unique(
+        m.num_vertices(), [&](std::size_t i) -> const Point& { return m.point(Vertex_index{i}); });
 
-    for (auto fi : m.faces()) {
+    std::vector<Face> faces(m.num_faces());
+    parallel_do(m.faces_begin(), m.faces_end(), [&](Face_index fi) {
       const auto& f = m.face(fi);
-      Face new_f{vi_map.at(f[0].idx()), vi_map.at(f[1].idx()), vi_map.at(f[2].idx())};
-      new_m.add_face(new_f);
-    }
+      faces.at(fi.idx()) = {Vertex_index{ids.at(f[0].idx())}, Vertex_index{ids.at(f[1].idx())},
+                            Vertex_index{ids.at(f[2].idx())}};
+    });
 
-    return new_m;
+    return {points.take_points(), std::move(faces), std::vector<FaceData>(m.num_faces())};
   }
 
   static std::vector<Vertex_index> isolated_vertices(const Triangle_soup& m) {
@@ -297,58 +285,48 @@ class Find_defects {
       points.insert(m.point(vi));
     }
 
-    const auto& tree = m.aabb_tree();
+    auto is_degenerate = [&](Face_index fi) {
+      return trivial_degenerate_faces.contains(fi) || non_trivial_degenerate_faces.contains(fi);
+    };
 
-    parallel_do(
-        m.faces_begin(), m.faces_end(),
+    m.aabb_tree().for_each_intersecting_leaf_pair(
         [&] {
           return std::make_tuple(
               boost::unordered_flat_map<Face_index, boost::unordered_flat_set<Face_index>>{},
-              Face_face_intersection{points}, std::vector<const Leaf*>{},
-              std::vector<Vertex_index>{});
+              Face_face_intersection{points}, std::vector<Vertex_index>{});
         },
-        [&](auto fi, auto& local_state) {
-          auto& [local_fis, face_face_intersection, leaves, shared_vertices] = local_state;
+        [&](const Leaf& leaf, const Leaf& leaf2, auto& local_state) {
+          auto& [local_fis, face_face_intersection, shared_vertices] = local_state;
 
-          if (trivial_degenerate_faces.contains(fi) || non_trivial_degenerate_faces.contains(fi)) {
+          auto fi = std::min(leaf.face_index(), leaf2.face_index());
+          auto fi2 = std::max(leaf.face_index(), leaf2.face_index());
+          if (is_degenerate(fi) || is_degenerate(fi2)) {
             return;
           }
 
-          leaves.clear();
-          tree.get_intersecting_leaves(std::back_inserter(leaves), internal::face_bbox(m, fi));
-
           auto f = m.face(fi);
           std::sort(f.begin(), f.end());
+          auto f2 = m.face(fi2);
+          std::sort(f2.begin(), f2.end());
 
-          for (const auto* leaf : leaves) {
-            auto fi2 = leaf->face_index();
-            if (fi2 <= fi || trivial_degenerate_faces.contains(fi2) ||
-                non_trivial_degenerate_faces.contains(fi2)) {
-              continue;
-            }
-
-            auto f2 = m.face(fi2);
-            std::sort(f2.begin(), f2.end());
-
-            auto inter = face_face_intersection(f[0].idx(), f[1].idx(), f[2].idx(), f2[0].idx(),
-                                                f2[1].idx(), f2[2].idx());
-            if (inter.empty()) {
-              continue;
-            }
+          auto inter = face_face_intersection(f[0].idx(), f[1].idx(), f[2].idx(), f2[0].idx(),
+                                              f2[1].idx(), f2[2].idx());
+          if (inter.empty()) {
+            return;
+          }
 
-            shared_vertices.clear();
-            std::set_intersection(f.begin(), f.end(), f2.begin(), f2.end(),
-                                  std::back_inserter(shared_vertices));
-            auto num_shared_vertices = shared_vertices.size();
+          shared_vertices.clear();
+          std::set_intersection(f.begin(), f.end(), f2.begin(), f2.end(),
+                                std::back_inserter(shared_vertices));
+          auto num_shared_vertices = shared_vertices.size();
 
-            if (num_shared_vertices < inter.size()) {
-              local_fis[fi].insert(fi2);
-              local_fis[fi2].insert(fi);
-            }
+          if (num_shared_vertices < inter.size()) {
+            local_fis[fi].insert(fi2);
+            local_fis[fi2].insert(fi);
           }
         },
         [&](auto& local_state) {
-          auto& [local_fis, face_face_intersection, leaves, shared_vertices] = local_state;
+          auto& [local_fis, face_face_intersection, shared_vertices] = local_state;
           if (fis.empty()) {
             fis = std::move(local_fis);
           } else {
@@ -3,10 +3,8 @@
 #include <kigumi/Face_tag.h>
 #include <kigumi/Mesh_indices.h>
 #include <kigumi/Triangle_soup.h>
-#include <kigumi/mesh_utility.h>
-#include <kigumi/parallel_do.h>
+#include <kigumi/parallel_sort.h>
 
-#include <iterator>
 #include <utility>
 #include <vector>
 
@@ -19,46 +17,27 @@ class Find_possibly_intersecting_faces {
   using Leaf = typename Triangle_soup::Leaf;
 
  public:
+  // Returns the pairs of faces whose bounding boxes overlap, sorted by the left face and then by
+  // the right face. The order keeps the pairs sharing vertices close to each other, and does not
+  // depend on the scheduling.
   std::vector<Face_index_pair> operator()(const Triangle_soup& left, const Triangle_soup& right,
                                           const std::vector<Face_tag>& left_face_tags,
                                           const std::vector<Face_tag>& right_face_tags) const {
     std::vector<Face_index_pair> pairs;
 
-    auto left_is_a = left.num_faces() < right.num_faces();
-    const auto& a = left_is_a ? left : right;
-    const auto& b = left_is_a ? right : left;
-    const auto& a_face_tags = left_is_a ? left_face_tags : right_face_tags;
-    const auto& b_face_tags = left_is_a ? right_face_tags : left_face_tags;
-    const auto& a_tree = a.aabb_tree();
-
-    parallel_do(
-        b.faces_begin(), b.faces_end(),
-        [&] { return std::make_pair(std::vector<Face_index_pair>{}, std::vector<const Leaf*>{}); },
-        [&](auto b_fi, auto& local_state) {
-          auto& [local_pairs, leaves] = local_state;
-
-          if (b_face_tags.at(b_fi.idx()) != Face_tag::UNKNOWN) {
+    left.aabb_tree().for_each_intersecting_leaf_pair(
+        right.aabb_tree(), [] { return std::vector<Face_index_pair>{}; },
+        [&](const Leaf& left_leaf, const Leaf& right_leaf, auto& local_pairs) {
+          auto left_fi = left_leaf.face_index();
+          auto right_fi = right_leaf.face_index();
+          if (left_face_tags.at(left_fi.idx()) != Face_tag::UNKNOWN ||
+              right_face_tags.at(right_fi.idx()) != Face_tag::UNKNOWN) {
             return;
           }
 
-          leaves.clear();
-          a_tree.get_intersecting_leaves(std::back_inserter(leaves), internal::face_bbox(b, b_fi));
-
-          for (const auto* leaf : leaves) {
-            auto a_fi = leaf->face_index();
-            if (a_face_tags.at(a_fi.idx()) != Face_tag::UNKNOWN) {
-              continue;
-            }
-
-            if (left_is_a) {
-              local_pairs.emplace_back(a_fi, b_fi);
-            } else {
-              local_pairs.emplace_back(b_fi, a_fi);
-            }
-          }
+          local_pairs.emplace_back(left_fi, right_fi);
         },
-        [&](auto& local_state) {
-          auto& [local_pairs, leaves] = local_state;
+        [&](auto& local_pairs) {
           if (pairs.empty()) {
             pairs = std::move(local_pairs);
           } else {
@@ -66,6 +45,8 @@ class Find_possibly_intersecting_faces {
           }
         });
 
+    parallel_sort(pairs.begin(), pairs.end());
+
     return pairs;
   }
 };
@@ -6,17 +6,33 @@
 #include <kigumi/Mesh_entities.h>
 #include <kigumi/Mesh_indices.h>
 #include <kigumi/Mixed.h>
+#include <kigumi/Task_graph.h>
 #include <kigumi/Triangle_soup.h>
 #include <kigumi/Warnings.h>
 #include <kigumi/parallel_do.h>
 
+#include <cstddef>
 #include <iostream>
 #include <iterator>
+#include <optional>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 namespace kigumi {
 
+// The statistics of a call to Mix.
+struct Mix_statistics {
+  // The number of the intersection points constructed, which are the last vertices of the mixed
+  // soup.
+  std::size_t num_intersection_points{};
+
+  // The total numbers of the orientations of the face pairs that are found in the caches of
+  // Face_face_intersection and are not, respectively.
+  std::size_t num_orientation_cache_hits{};
+  std::size_t num_orientation_cache_misses{};
+};
+
 template <class K, class FaceData>
 class Mix {
   using Classify_faces_globally = Classify_faces_globally<K, FaceData>;
@@ -27,34 +43,54 @@ class Mix {
   using Triangle_soup = Triangle_soup<K, FaceData>;
 
  public:
-  std::pair<Mixed_triangle_soup, Warnings> operator()(const Triangle_soup& left,
-                                                      const Triangle_soup& right) const {
+  std::tuple<Mixed_triangle_soup, Warnings, Mix_statistics> operator()(
+      const Triangle_soup& left, const Triangle_soup& right) const {
     Corefine corefine{left, right};
 
     std::cout << "Constructing mixed mesh..." << std::endl;
 
+    // The faces from each side are collected concurrently, and the border edges are found
+    // while the mixed mesh is being finalized.
+    Task_graph graph;
     std::vector<Face> faces;
     std::vector<Mixed_face_data> face_data;
-
-    for (auto fi : left.faces()) {
-      auto [tag, count] = corefine.get_left_faces(fi, std::back_inserter(faces));
-      Mixed_face_data data{true, tag, left.data(fi)};
-      face_data.resize(face_data.size() + count, data);
-    }
-
-    for (auto fi : right.faces()) {
-      auto [tag, count] = corefine.get_right_faces(fi, std::back_inserter(faces));
-      Mixed_face_data data{false, tag, right.data(fi)};
-      face_data.resize(face_data.size() + count, data);
-    }
-
-    Mixed_triangle_mesh m(corefine.take_points(), std::move(faces), std::move(face_data));
-    m.finalize();
+    std::vector<Face> right_faces;
+    std::vector<Mixed_face_data> right_face_data;
+    std::optional<Mixed_triangle_mesh> m;
+    Edge_set border_edges;
+    std::vector<Edge> intersecting_edges;
+
+    auto collect_left_faces = graph.add([&] {
+      for (auto fi : left.faces()) {
+        auto [tag, count] = corefine.get_left_faces(fi, std::back_inserter(faces));
+        Mixed_face_data data{true, tag, left.data(fi)};
+        face_data.resize(face_data.size() + count, data);
+      }
+    });
+    auto collect_right_faces = graph.add([&] {
+      for (auto fi : right.faces()) {
+        auto [tag, count] = corefine.get_right_faces(fi, std::back_inserter(right_faces));
+        Mixed_face_data data{false, tag, right.data(fi)};
+        right_face_data.resize(right_face_data.size() + count, data);
+      }
+    });
+    graph.add(
+        [&] {
+          faces.insert(faces.end(), right_faces.begin(), right_faces.end());
+          face_data.insert(face_data.end(), std::make_move_iterator(right_face_data.begin()),
+                           std::make_move_iterator(right_face_data.end()));
+          m.emplace(corefine.take_points(), std::move(faces), std::move(face_data));
+          m->finalize();
+        },
+        {collect_left_faces, collect_right_faces});
+    graph.add([&] {
+      border_edges = corefine.get_intersecting_edges();
+      intersecting_edges.assign(border_edges.begin(), border_edges.end());
+    });
+    graph.run();
 
     std::cout << "Local classification..." << std::endl;
 
-    auto border_edges = corefine.get_intersecting_edges();
-    std::vector<Edge> intersecting_edges(border_edges.begin(), border_edges.end());
     Warnings warnings{};
 
     parallel_do(
@@ -62,7 +98,7 @@ class Mix {
         [&] { return std::make_pair(Warnings{}, Classify_faces_locally{}); },
         [&](const auto& edge, auto& local_state) {
           auto& [local_warnings, classify_faces_locally] = local_state;
-          local_warnings |= classify_faces_locally(m, edge, border_edges);
+          local_warnings |= classify_faces_locally(*m, edge, border_edges);
         },
         [&](auto& local_state) {
           auto& [local_warnings, classify_faces_locally] = local_state;
@@ -72,9 +108,14 @@ class Mix {
     std::cout << "Global classification..." << std::endl;
 
     Classify_faces_globally classify_faces_globally;
-    warnings |= classify_faces_globally(m, border_edges, left, right);
+    warnings |= classify_faces_globally(*m, border_edges, left, right);
+
+    Mix_statistics stats;
+    stats.num_intersection_points = m->num_vertices() - corefine.first_intersection_point_id();
+    stats.num_orientation_cache_hits = corefine.num_orientation_cache_hits();
+    stats.num_orientation_cache_misses = corefine.num_orientation_cache_misses();
 
-    return {m.take_triangle_soup(), warnings};
+    return {m->take_triangle_soup(), warnings, stats};
   }
 };
 
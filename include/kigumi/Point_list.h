@@ -1,7 +1,14 @@
 #pragma once
 
+#include <kigumi/parallel_do.h>
+#include <kigumi/parallel_scan.h>
+#include <kigumi/parallel_sort.h>
+
+#include <algorithm>
 #include <boost/container_hash/hash.hpp>
 #include <boost/unordered/unordered_flat_map.hpp>
+#include <iterator>
+#include <numeric>
 #include <utility>
 #include <vector>
 
@@ -49,6 +56,79 @@ class Point_list {
     return it->second;
   }
 
+  // Appends the points without checking uniqueness and returns the index of the first one.
+  std::size_t append(std::vector<Point>&& points) {
+    auto first = points_.size();
+    points_.insert(points_.end(), std::make_move_iterator(points.begin()),
+                   std::make_move_iterator(points.end()));
+    return first;
+  }
+
+  // Inserts the points point_at(0), ..., point_at(num_points - 1) with deduplication in parallel,
+  // and returns their ids. The ids are the same as those returned by inserting the points one
+  // by one with the uniqueness check, except that the points already in the list are not
+  // considered.
+  template <class PointAt>
+  std::vector<std::size_t> insert_unique(std::size_t num_points, PointAt point_at) {
+    std::vector<std::size_t> indices(num_points);
+    std::iota(indices.begin(), indices.end(), std::size_t{0});
+
+    // {hash, index} pairs sorted so that equal points are adjacent and in the order of insertion.
+    std::vector<std::pair<std::size_t, std::size_t>> hashes(num_points);
+    parallel_do(indices.begin(), indices.end(), [&](std::size_t i) {
+      hashes.at(i) = {Point_3_hash<K>{}(point_at(i)), i};
+    });
+    parallel_sort(hashes.begin(), hashes.end());
+
+    // The smallest index of the points equal to each point.
+    std::vector<std::size_t> representatives(num_points);
+    parallel_do(indices.begin(), indices.end(), [&](std::size_t k) {
+      auto hash = hashes.at(k).first;
+      if (k != 0 && hashes.at(k - 1).first == hash) {
+        return;
+      }
+
+      auto end = k + 1;
+      while (end < num_points && hashes.at(end).first == hash) {
+        ++end;
+      }
+
+      std::vector<std::size_t> distinct;
+      for (auto j = k; j < end; ++j) {
+        auto i = hashes.at(j).second;
+        auto it = std::find_if(distinct.begin(), distinct.end(),
+                               [&](std::size_t d) { return point_at(d) == point_at(i); });
+        if (it == distinct.end()) {
+          distinct.push_back(i);
+          representatives.at(i) = i;
+        } else {
+          representatives.at(i) = *it;
+        }
+      }
+    });
+
+    std::vector<std::size_t> ids(num_points);
+    parallel_do(indices.begin(), indices.end(),
+                [&](std::size_t i) { ids.at(i) = representatives.at(i) == i ? 1 : 0; });
+    auto first_id = points_.size();
+    auto num_ids = parallel_exclusive_scan(ids.begin(), ids.end(), ids.begin(), first_id);
+
+    points_.resize(num_ids);
+    parallel_do(indices.begin(), indices.end(), [&](std::size_t i) {
+      if (representatives.at(i) == i) {
+        points_.at(ids.at(i)) = point_at(i);
+      }
+    });
+    parallel_do(indices.begin(), indices.end(), [&](std::size_t i) {
+      auto rep = representatives.at(i);
+      if (rep != i) {
+        ids.at(i) = ids.at(rep);
+      }
+    });
+
+    return ids;
+  }
+
   std::vector<Point> take_points() { return std::move(points_); }
 
   void reserve(std::size_t capacity) {
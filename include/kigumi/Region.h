@@ -5,10 +5,16 @@
 #include <kigumi/Side_of_triangle_soup.h>
 #include <kigumi/Triangle_soup.h>
 #include <kigumi/io.h>
+#include <kigumi/parallel_do.h>
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <ranges>
+#include <span>
 #include <utility>
+#include <vector>
 
 namespace kigumi {
 
@@ -76,6 +82,25 @@ class Region {
     }
   }
 
+  // Classifies the points in parallel, which is equivalent to calling bounded_side(p)
+  // for each point p.
+  std::vector<CGAL::Bounded_side> bounded_side(std::span<const Point> points) const {
+    std::vector<CGAL::Bounded_side> sides(points.size());
+    if (is_empty_or_full()) {
+      std::fill(sides.begin(), sides.end(),
+                is_empty() ? CGAL::ON_UNBOUNDED_SIDE : CGAL::ON_BOUNDED_SIDE);
+      return sides;
+    }
+
+    // Build the AABB tree once, rather than in each thread that finds it missing.
+    boundary_.aabb_tree();
+
+    auto indices = std::views::iota(std::size_t{0}, points.size());
+    parallel_do(indices.begin(), indices.end(),
+                [&](std::size_t i) { sides.at(i) = bounded_side(points[i]); });
+    return sides;
+  }
+
   static Region empty() { return Region{Region_kind::EMPTY}; }
 
   static Region full() { return Region{Region_kind::FULL}; }
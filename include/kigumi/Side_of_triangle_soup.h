@@ -1,27 +1,43 @@
 #pragma once
 
+#include <CGAL/Bbox_3.h>
+#include <CGAL/Interval_nt.h>
 #include <CGAL/Kernel/global_functions.h>
 #include <CGAL/enum.h>
 #include <CGAL/intersections.h>
+#include <kigumi/AABB_tree/AABB_ray.h>
+#include <kigumi/AABB_tree/AABB_tree.h>
 #include <kigumi/Mesh_indices.h>
 #include <kigumi/Triangle_soup.h>
-#include <kigumi/mesh_utility.h>
 
 #include <algorithm>
-#include <iterator>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <stdexcept>
 #include <variant>
-#include <vector>
 
 namespace kigumi {
 
+// Determines the side of a point with respect to a triangle soup, which is the side of the point
+// with respect to the supporting plane of the nearest face hit by a ray from the point.
+//
+// The faces crossed by the ray and the order of the crossings are determined by orientation
+// predicates, and the crossing points are only constructed if the order cannot be determined
+// otherwise. If the ray passes through an edge or a vertex, or hits two faces at the same point,
+// another ray is cast toward a face chosen far from the previous one in the face order.
 template <class K, class FaceData>
 class Side_of_triangle_soup {
-  using FT = typename K::FT;
+  using Bbox = CGAL::Bbox_3;
+  using Interval = CGAL::Interval_nt<>;
+  using Interval_vector = std::array<Interval, 3>;
   using Leaf = typename Triangle_soup<K, FaceData>::Leaf;
+  using Line = typename K::Line_3;
   using Point = typename K::Point_3;
   using Ray = typename K::Ray_3;
-  using Segment = typename K::Segment_3;
   using Triangle_soup = Triangle_soup<K, FaceData>;
 
  public:
@@ -31,73 +47,255 @@ class Side_of_triangle_soup {
     }
 
     const auto& tree = soup.aabb_tree();
+    auto num_faces = soup.num_faces();
+    auto stride = scatter_stride(num_faces);
+    std::size_t trg_index{};
+    for (std::size_t i = 0; i < num_faces; ++i, trg_index = (trg_index + stride) % num_faces) {
+      auto q = ray_target(soup, Face_index{trg_index});
 
-    for (auto fi_trg : soup.faces()) {
-      leaves_.clear();
-      intersections_.clear();
-
-      auto p_trg = internal::face_centroid(soup, fi_trg);
-
-      if (p == p_trg) {
+      if (p == q) {
         return CGAL::ON_ORIENTED_BOUNDARY;
       }
 
-      Ray ray{p, p_trg};
-      tree.get_intersecting_leaves(std::back_inserter(leaves_), ray);
+      auto result = cast_ray(soup, tree, p, q);
+      switch (result.kind) {
+        case Ray_result_kind::ON_BOUNDARY:
+          return CGAL::ON_ORIENTED_BOUNDARY;
+        case Ray_result_kind::DEGENERATE:
+          continue;
+        case Ray_result_kind::NO_HIT:
+          // The point is outside the convex boundary of the mesh, etc.
+          throw std::runtime_error("cannot determine the side of the point");
+        case Ray_result_kind::HIT:
+          return result.side;
+      }
+    }
+
+    // Should not happen.
+    throw std::runtime_error("cannot determine the side of the point");
+  }
+
+ private:
+  enum class Ray_result_kind : std::uint8_t {
+    // The point lies on a face.
+    ON_BOUNDARY,
+    // The ray passes through an edge or a vertex, or hits two faces at the same point.
+    DEGENERATE,
+    NO_HIT,
+    HIT,
+  };
 
-      for (const auto* leaf : leaves_) {
-        auto fi = leaf->face_index();
-        auto tri = soup.triangle(fi);
+  struct Ray_result {
+    Ray_result_kind kind;
+    // The side of the point with respect to the supporting plane of the nearest face.
+    CGAL::Oriented_side side;
+  };
 
-        auto result = CGAL::intersection(tri, ray);
-        if (!result) {
-          continue;
-        }
+  struct Face_points {
+    const Point& a;
+    const Point& b;
+    const Point& c;
+  };
+
+  // Casts the ray from p through q. The faces are visited front to back, and those beyond
+  // the nearest crossing found so far are skipped.
+  static Ray_result cast_ray(const Triangle_soup& soup, const AABB_tree<Leaf>& tree,
+                             const Point& p, const Point& q) {
+    Ray ray{p, q};
+    auto p_approx = to_interval(p);
+    auto dir_approx = to_interval(q);
+    for (std::size_t i = 0; i < 3; ++i) {
+      dir_approx.at(i) -= p_approx.at(i);
+    }
+
+    auto kind = Ray_result_kind::NO_HIT;
+    auto side = CGAL::ON_ORIENTED_BOUNDARY;
+    Face_index nearest;
+    auto tied = false;
+    auto t_bound = std::numeric_limits<double>::infinity();
+    auto stop = [&](Ray_result_kind stop_kind) {
+      kind = stop_kind;
+      return -std::numeric_limits<double>::infinity();
+    };
 
-        if (const auto* point = std::get_if<Point>(&*result)) {
-          if (*point == p) {
-            return CGAL::ON_ORIENTED_BOUNDARY;
+    tree.for_each_intersecting_leaf_by_distance(
+        AABB_ray{ray, p_approx, dir_approx},
+        [&](const Bbox& bbox) { return entry_lower_bound(bbox, p_approx, dir_approx); },
+        [&](const Leaf& leaf) {
+          auto fi = leaf.face_index();
+          auto [a, b, c] = face_points(soup, fi);
+
+          auto p_side = CGAL::orientation(a, b, c, p);
+          if (p_side == CGAL::COPLANAR) {
+            if (soup.triangle(fi).has_on(p)) {
+              return stop(Ray_result_kind::ON_BOUNDARY);
+            }
+            // The ray does not cross the face, or lies on its supporting plane. The latter case
+            // is ignored, as the ray crosses the adjacent faces.
+            return t_bound;
           }
-          auto d = CGAL::squared_distance(p, *point);
-          intersections_.emplace_back(std::move(d), fi);
-        } else if (const auto* segment = std::get_if<Segment>(&*result)) {
-          if (segment->source() == p || segment->target() == p) {
-            return CGAL::ON_ORIENTED_BOUNDARY;
+
+          // The line pq passes through the face iff the three orientations have the same sign,
+          // and the crossing is on the ray iff the sign is opposite to p_side.
+          std::array<CGAL::Orientation, 3> edge_sides{CGAL::orientation(p, q, a, b),
+                                                      CGAL::orientation(p, q, b, c),
+                                                      CGAL::orientation(p, q, c, a)};
+          if (std::find(edge_sides.begin(), edge_sides.end(), p_side) != edge_sides.end()) {
+            return t_bound;
+          }
+          if (std::find(edge_sides.begin(), edge_sides.end(), CGAL::COPLANAR) !=
+              edge_sides.end()) {
+            // The ray passes through an edge or a vertex.
+            return stop(Ray_result_kind::DEGENERATE);
           }
-          // Ignore.
-        }
-      }
 
-      if (intersections_.empty()) {
-        // The point is outside the convex boundary of the mesh, etc.
-        throw std::runtime_error("cannot determine the side of the point");
-      }
+          auto order = kind == Ray_result_kind::HIT
+                           ? compare_crossings(soup, p, q, fi, nearest)
+                           : CGAL::SMALLER;
+          if (order == CGAL::EQUAL) {
+            tied = true;
+          } else if (order == CGAL::SMALLER) {
+            kind = Ray_result_kind::HIT;
+            side = p_side;
+            nearest = fi;
+            tied = false;
+            t_bound = crossing_upper_bound(soup, fi, p_approx, dir_approx);
+          }
+          return t_bound;
+        });
 
-      if (intersections_.size() >= 2) {
-        std::partial_sort(intersections_.begin(), intersections_.begin() + 2, intersections_.end(),
-                          [](const auto& a, const auto& b) { return a.distance < b.distance; });
+    if (kind == Ray_result_kind::HIT && tied) {
+      kind = Ray_result_kind::DEGENERATE;
+    }
+    return {kind, side};
+  }
 
-        if (intersections_.at(0).distance == intersections_.at(1).distance) {
-          // The ray touches or passes through an edge or a vertex shared by two or more triangles.
-          continue;
-        }
+  // Compares the parameters t of the points at which the ray p + t (q - p) crosses the faces
+  // fi and fi2.
+  static CGAL::Comparison_result compare_crossings(const Triangle_soup& soup, const Point& p,
+                                                   const Point& q, Face_index fi,
+                                                   Face_index fi2) {
+    // The crossing with fi precedes the crossing with fi2 iff it is on the same side as p
+    // with respect to the supporting plane of fi2. The side is known without constructing
+    // the crossing if fi does not straddle the plane.
+    if (auto side = side_of_face(soup, fi, fi2)) {
+      if (*side == CGAL::ON_ORIENTED_BOUNDARY) {
+        return CGAL::EQUAL;
       }
+      auto [a, b, c] = face_points(soup, fi2);
+      return *side == CGAL::orientation(a, b, c, p) ? CGAL::SMALLER : CGAL::LARGER;
+    }
 
-      return internal::oriented_side_of_face_supporting_plane(soup, intersections_.at(0).fi, p);
+    if (auto side = side_of_face(soup, fi2, fi)) {
+      auto [a, b, c] = face_points(soup, fi);
+      return *side == CGAL::orientation(a, b, c, p) ? CGAL::LARGER : CGAL::SMALLER;
     }
 
-    // Should not happen.
-    throw std::runtime_error("cannot determine the side of the point");
+    // Each face straddles the supporting plane of the other.
+    Line line{p, q};
+    auto x = crossing_point(soup, fi, line);
+    auto x2 = crossing_point(soup, fi2, line);
+    return CGAL::compare_distance_to_point(p, x, x2);
   }
 
- private:
-  struct Intersection {
-    FT distance;
-    Face_index fi;
-  };
+  // Returns the side of the interior of the face fi with respect to the supporting plane of
+  // the face fi2, or std::nullopt if the face straddles the plane.
+  static std::optional<CGAL::Oriented_side> side_of_face(const Triangle_soup& soup, Face_index fi,
+                                                         Face_index fi2) {
+    auto [a, b, c] = face_points(soup, fi2);
+    auto has_negative = false;
+    auto has_positive = false;
+    for (auto vi : soup.face(fi)) {
+      auto side = CGAL::orientation(a, b, c, soup.point(vi));
+      has_negative = has_negative || side == CGAL::NEGATIVE;
+      has_positive = has_positive || side == CGAL::POSITIVE;
+    }
+
+    if (has_negative && has_positive) {
+      return std::nullopt;
+    }
+    return has_negative   ? CGAL::ON_NEGATIVE_SIDE
+           : has_positive ? CGAL::ON_POSITIVE_SIDE
+                          : CGAL::ON_ORIENTED_BOUNDARY;
+  }
+
+  static Point crossing_point(const Triangle_soup& soup, Face_index fi, const Line& line) {
+    auto result = CGAL::intersection(soup.triangle(fi).supporting_plane(), line);
+    return std::get<Point>(*result);
+  }
+
+  static Face_points face_points(const Triangle_soup& soup, Face_index fi) {
+    const auto& f = soup.face(fi);
+    return {soup.point(f[0]), soup.point(f[1]), soup.point(f[2])};
+  }
+
+  // Returns a point in the interior of the face. It is not the centroid, which is more likely
+  // to be aligned with the vertices of regular meshes.
+  static Point ray_target(const Triangle_soup& soup, Face_index fi) {
+    auto [a, b, c] = face_points(soup, fi);
+    return CGAL::barycenter(a, 1, b, 2, c, 4);
+  }
 
-  mutable std::vector<const Leaf*> leaves_;
-  mutable std::vector<Intersection> intersections_;
+  // Returns a stride coprime to num_faces, so that stepping by it visits every face,
+  // and consecutive faces are far apart in the face order.
+  static std::size_t scatter_stride(std::size_t num_faces) {
+    auto stride = static_cast<std::size_t>(0.618 * static_cast<double>(num_faces)) + 1;
+    while (std::gcd(stride, num_faces) != 1) {
+      ++stride;
+    }
+    return stride;
+  }
+
+  static Interval_vector to_interval(const Point& p) {
+    const auto& approx = p.approx();
+    return {Interval{CGAL::to_interval(approx.x())}, Interval{CGAL::to_interval(approx.y())},
+            Interval{CGAL::to_interval(approx.z())}};
+  }
+
+  // Returns a lower bound of the parameters t at which the ray p + t * dir is in the box.
+  static double entry_lower_bound(const Bbox& bbox, const Interval_vector& p,
+                                  const Interval_vector& dir) {
+    auto t = 0.0;
+    for (auto i = 0; i < 3; ++i) {
+      if (dir.at(i).inf() > 0.0) {
+        t = std::max(t, ((Interval{bbox.min(i)} - p.at(i)) / dir.at(i)).inf());
+      } else if (dir.at(i).sup() < 0.0) {
+        t = std::max(t, ((Interval{bbox.max(i)} - p.at(i)) / dir.at(i)).inf());
+      }
+    }
+    return t;
+  }
+
+  // Returns an upper bound of the parameter t at which the ray p + t * dir crosses
+  // the supporting plane of the face.
+  static double crossing_upper_bound(const Triangle_soup& soup, Face_index fi,
+                                     const Interval_vector& p, const Interval_vector& dir) {
+    auto [a, b, c] = face_points(soup, fi);
+    auto a_approx = to_interval(a);
+    auto b_approx = to_interval(b);
+    auto c_approx = to_interval(c);
+
+    Interval_vector ab;
+    Interval_vector ac;
+    Interval_vector pa;
+    for (std::size_t i = 0; i < 3; ++i) {
+      ab.at(i) = b_approx.at(i) - a_approx.at(i);
+      ac.at(i) = c_approx.at(i) - a_approx.at(i);
+      pa.at(i) = a_approx.at(i) - p.at(i);
+    }
+
+    // t = n . (a - p) / n . dir, where n = (b - a) x (c - a).
+    Interval n_dot_pa{0.0};
+    Interval n_dot_dir{0.0};
+    for (std::size_t i = 0; i < 3; ++i) {
+      auto j = (i + 1) % 3;
+      auto k = (i + 2) % 3;
+      auto n = ab.at(j) * ac.at(k) - ab.at(k) * ac.at(j);
+      n_dot_pa += n * pa.at(i);
+      n_dot_dir += n * dir.at(i);
+    }
+    return (n_dot_pa / n_dot_dir).sup();
+  }
 };
 
 }  // namespace kigumi
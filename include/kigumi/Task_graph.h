@@ -0,0 +1,79 @@
+#pragma once
+
+#include <kigumi/Thread_pool.h>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace kigumi {
+
+// A set of tasks with dependencies between them.
+//
+// run() starts each task as soon as all of its dependencies are finished, so independent tasks
+// run concurrently. If a task throws, the tasks that depend on it are not run, and the exception
+// is rethrown by run() after the other tasks are finished.
+class Task_graph {
+ public:
+  using Task_id = std::size_t;
+
+  // Adds a task that runs after the tasks dependencies, which must have been added before.
+  Task_id add(std::function<void()> task, std::initializer_list<Task_id> dependencies = {}) {
+    auto id = nodes_.size();
+    auto node = std::make_unique<Node>();
+    node->task = std::move(task);
+    for (auto dep : dependencies) {
+      if (dep >= id) {
+        throw std::invalid_argument("dependencies must be added before the task");
+      }
+      nodes_.at(dep)->successors.push_back(id);
+      ++node->num_dependencies;
+    }
+    nodes_.push_back(std::move(node));
+    return id;
+  }
+
+  void run() {
+    for (auto& node : nodes_) {
+      node->num_pending_dependencies.store(node->num_dependencies, std::memory_order_relaxed);
+    }
+
+    Task_group group;
+    for (Task_id id = 0; id < nodes_.size(); ++id) {
+      if (nodes_.at(id)->num_dependencies == 0) {
+        schedule(group, id);
+      }
+    }
+    group.wait();
+  }
+
+ private:
+  struct Node {
+    std::function<void()> task;
+    std::vector<Task_id> successors;
+    std::size_t num_dependencies{};
+    std::atomic<std::size_t> num_pending_dependencies{};
+  };
+
+  void schedule(Task_group& group, Task_id id) {
+    group.run([this, &group, id] {
+      const auto& node = *nodes_.at(id);
+      node.task();
+      for (auto succ : node.successors) {
+        if (nodes_.at(succ)->num_pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) ==
+            1) {
+          schedule(group, succ);
+        }
+      }
+    });
+  }
+
+  std::vector<std::unique_ptr<Node>> nodes_;
+};
+
+}  // namespace kigumi
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <kigumi/threading.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace kigumi {
+
+// A process-wide pool of worker threads.
+//
+// Each worker owns a deque of tasks. A worker pops tasks from the back of its own deque and steals
+// tasks from the front of the others when it runs out of work. Workers are started lazily, so
+// that no threads are created until parallel work is actually submitted.
+class Thread_pool {
+ public:
+  using Task = std::function<void()>;
+
+  Thread_pool(const Thread_pool&) = delete;
+  Thread_pool(Thread_pool&&) = delete;
+  Thread_pool& operator=(const Thread_pool&) = delete;
+  Thread_pool& operator=(Thread_pool&&) = delete;
+
+  ~Thread_pool() {
+    {
+      std::lock_guard lock{sleep_mutex_};
+      stop_ = true;
+    }
+    sleep_cv_.notify_all();
+
+    for (auto& worker : workers_) {
+      if (worker->thread.joinable()) {
+        worker->thread.join();
+      }
+    }
+  }
+
+  static Thread_pool& instance() {
+    static Thread_pool pool;
+    return pool;
+  }
+
+  // The maximum number of workers, which is one less than the maximum number of threads
+  // as the thread that submits tasks also takes part in executing them.
+  std::size_t max_num_workers() const { return workers_.size(); }
+
+  std::size_t num_workers() const { return num_workers_.load(std::memory_order_acquire); }
+
+  // Starts workers until at least min(num_workers, max_num_workers()) of them are running.
+  void reserve_workers(std::size_t num_workers) {
+    num_workers = std::min(num_workers, max_num_workers());
+    if (this->num_workers() >= num_workers) {
+      return;
+    }
+
+    std::lock_guard lock{start_mutex_};
+    auto n = num_workers_.load(std::memory_order_relaxed);
+    for (; n < num_workers; ++n) {
+      workers_.at(n)->thread = std::thread{&Thread_pool::worker_loop, this, n};
+      num_workers_.store(n + 1, std::memory_order_release);
+    }
+  }
+
+  void submit(Task task) {
+    auto n = num_workers();
+    if (n == 0) {
+      // No one would ever run the task.
+      task();
+      return;
+    }
+
+    auto index = worker_index_ < n ? worker_index_ : next_worker_++ % n;
+    auto& worker = *workers_.at(index);
+
+    num_queued_tasks_.fetch_add(1, std::memory_order_acq_rel);
+    {
+      std::lock_guard lock{worker.mutex};
+      worker.tasks.push_back(std::move(task));
+    }
+
+    {
+      std::lock_guard lock{sleep_mutex_};
+    }
+    sleep_cv_.notify_all();
+  }
+
+  // Runs a queued task on the calling thread. Returns false if there were no queued tasks.
+  bool run_queued_task() {
+    Task task;
+    if (!pop_task(task)) {
+      return false;
+    }
+
+    task();
+    return true;
+  }
+
+  // Blocks the calling thread until done() returns true or a task gets queued.
+  template <class Predicate>
+  void wait_for_task_or(Predicate done) {
+    std::unique_lock lock{sleep_mutex_};
+    sleep_cv_.wait(lock, [&] {
+      return done() || num_queued_tasks_.load(std::memory_order_acquire) != 0;
+    });
+  }
+
+  // Wakes up the threads blocked in wait_for_task_or().
+  void notify() {
+    {
+      std::lock_guard lock{sleep_mutex_};
+    }
+    sleep_cv_.notify_all();
+  }
+
+ private:
+  static constexpr std::size_t kNotAWorker = std::numeric_limits<std::size_t>::max();
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  Thread_pool() {
+    auto max_num_threads =
+        static_cast<std::size_t>(std::max(1U, std::thread::hardware_concurrency()));
+    workers_.reserve(max_num_threads - 1);
+    for (std::size_t i = 0; i < max_num_threads - 1; ++i) {
+      workers_.push_back(std::make_unique<Worker>());
+    }
+  }
+
+  void worker_loop(std::size_t index) {
+    worker_index_ = index;
+
+    while (true) {
+      if (run_queued_task()) {
+        continue;
+      }
+
+      std::unique_lock lock{sleep_mutex_};
+      sleep_cv_.wait(lock, [&] {
+        return stop_ || num_queued_tasks_.load(std::memory_order_acquire) != 0;
+      });
+      if (stop_ && num_queued_tasks_.load(std::memory_order_acquire) == 0) {
+        break;
+      }
+    }
+  }
+
+  bool pop_task(Task& task) {
+    auto n = num_workers();
+
+    if (worker_index_ < n) {
+      auto& worker = *workers_.at(worker_index_);
+      std::lock_guard lock{worker.mutex};
+      if (!worker.tasks.empty()) {
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        num_queued_tasks_.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+      }
+    }
+
+    auto first = worker_index_ < n ? worker_index_ + 1 : 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      auto& victim = *workers_.at((first + i) % n);
+      std::lock_guard lock{victim.mutex};
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        num_queued_tasks_.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  static thread_local inline std::size_t worker_index_{kNotAWorker};
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<std::size_t> num_workers_{};
+  std::atomic<std::size_t> next_worker_{};
+  std::atomic<std::size_t> num_queued_tasks_{};
+  std::mutex start_mutex_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  bool stop_{};
+};
+
+// A set of tasks submitted to the Thread_pool that can be waited for together.
+//
+// Tasks run with the Threading_context of the thread that submitted them.
+// While waiting, the calling thread executes queued tasks, so task groups can be nested.
+class Task_group {
+ public:
+  Task_group() = default;
+
+  ~Task_group() {
+    try {
+      wait();
+    } catch (...) {
+      // The exception is lost.
+    }
+  }
+
+  Task_group(const Task_group&) = delete;
+  Task_group(Task_group&&) = delete;
+  Task_group& operator=(const Task_group&) = delete;
+  Task_group& operator=(Task_group&&) = delete;
+
+  template <class Function>
+  void run(Function f) {
+    auto options = Threading_context::current();
+    if (options.num_threads() == 1) {
+      invoke(f);
+      return;
+    }
+
+    auto& pool = Thread_pool::instance();
+    pool.reserve_workers(options.num_threads() - 1);
+
+    num_pending_tasks_.fetch_add(1, std::memory_order_acq_rel);
+    pool.submit([this, &pool, options, f = std::move(f)]() mutable {
+      {
+        Threading_context threading_ctx{options};
+        invoke(f);
+      }
+
+      // *this may be destroyed as soon as the counter reaches zero.
+      if (num_pending_tasks_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pool.notify();
+      }
+    });
+  }
+
+  // Waits for all tasks to complete, and then rethrows the first exception thrown by them, if any.
+  void wait() {
+    auto& pool = Thread_pool::instance();
+    auto done = [&] { return num_pending_tasks_.load(std::memory_order_acquire) == 0; };
+
+    while (!done()) {
+      if (!pool.run_queued_task()) {
+        pool.wait_for_task_or(done);
+      }
+    }
+
+    std::exception_ptr exception_ptr;
+    {
+      std::lock_guard lock{mutex_};
+      std::swap(exception_ptr, exception_ptr_);
+    }
+
+    if (exception_ptr) {
+      std::rethrow_exception(exception_ptr);
+    }
+  }
+
+ private:
+  template <class Function>
+  void invoke(Function& f) {
+    try {
+      f();
+    } catch (...) {
+      std::lock_guard lock{mutex_};
+      if (!exception_ptr_) {
+        exception_ptr_ = std::current_exception();
+      }
+    }
+  }
+
+  std::atomic<std::size_t> num_pending_tasks_{};
+  std::mutex mutex_;
+  std::exception_ptr exception_ptr_;
+};
+
+}  // namespace kigumi
@@ -6,8 +6,11 @@
 #include <kigumi/Mesh_iterators.h>
 #include <kigumi/Null_data.h>
 #include <kigumi/Triangle_soup.h>
-#include <kigumi/parallel_sort.h>
+#include <kigumi/parallel_do.h>
+#include <kigumi/parallel_scan.h>
 
+#include <algorithm>
+#include <atomic>
 #include <boost/range/iterator_range.hpp>
 #include <utility>
 #include <vector>
@@ -101,36 +104,38 @@ class Triangle_mesh {
     return Face_index{faces_.size() - 1};
   }
 
+  // Builds the vertex-to-face incidence in the CSR format: the faces around vertex vi are
+  // face_indices_[indices_[vi], indices_[vi + 1]), sorted by index.
   void finalize() {
-    std::vector<std::pair<Vertex_index, Face_index>> map;
-    map.reserve(3 * faces_.size());
-    {
-      Face_index fi{0};
-      for (const auto& face : faces_) {
-        map.emplace_back(face[0], fi);
-        map.emplace_back(face[1], fi);
-        map.emplace_back(face[2], fi);
-        ++fi;
-      }
-    }
-
-    parallel_sort(map.begin(), map.end());
-
-    face_indices_.reserve(3 * faces_.size());
-    indices_.reserve(points_.size() + 1);
-    std::size_t index{};
-    std::ptrdiff_t prev_v{-1};
-    for (auto [vi, fi] : map) {
-      face_indices_.push_back(fi);
+    auto num_vertices = points_.size();
 
-      auto v = static_cast<std::ptrdiff_t>(vi.idx());
-      for (std::ptrdiff_t i = 0; i < v - prev_v; ++i) {
-        indices_.push_back(index);
+    // The number of faces around each vertex, and then the next free slot in face_indices_.
+    std::vector<std::atomic<std::size_t>> cursors(num_vertices);
+    parallel_do(faces_begin(), faces_end(), [&](Face_index fi) {
+      for (auto vi : face(fi)) {
+        cursors.at(vi.idx()).fetch_add(1, std::memory_order_relaxed);
       }
-      prev_v = v;
-      ++index;
-    }
-    indices_.push_back(index);
+    });
+
+    indices_.assign(num_vertices + 1, 0);
+    indices_.back() =
+        parallel_exclusive_scan(cursors.begin(), cursors.end(), indices_.begin(), std::size_t{0});
+    parallel_do(vertices_begin(), vertices_end(), [&](Vertex_index vi) {
+      cursors.at(vi.idx()).store(indices_.at(vi.idx()), std::memory_order_relaxed);
+    });
+
+    face_indices_.assign(indices_.back(), Face_index{});
+    parallel_do(faces_begin(), faces_end(), [&](Face_index fi) {
+      for (auto vi : face(fi)) {
+        auto slot = cursors.at(vi.idx()).fetch_add(1, std::memory_order_relaxed);
+        face_indices_.at(slot) = fi;
+      }
+    });
+
+    parallel_do(vertices_begin(), vertices_end(), [&](Vertex_index vi) {
+      std::sort(face_indices_.begin() + indices_.at(vi.idx()),
+                face_indices_.begin() + indices_.at(vi.idx() + 1));
+    });
   }
 
   std::size_t num_vertices() const { return points_.size(); }
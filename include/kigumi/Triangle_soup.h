@@ -12,11 +12,14 @@
 #include <kigumi/io.h>
 #include <kigumi/mesh_utility.h>
 
+#include <array>
+#include <atomic>
 #include <boost/range/iterator_range.hpp>
 #include <cstdint>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
 #include <utility>
 #include <vector>
 
@@ -47,28 +50,40 @@ class Triangle_soup {
   ~Triangle_soup() = default;
 
   Triangle_soup(const Triangle_soup& other)
-      : points_{other.points_}, faces_{other.faces_}, face_data_{other.face_data_} {}
+      : faces_{other.faces_},
+        face_data_{other.face_data_},
+        aabb_split_method_{other.aabb_split_method_},
+        aabb_tree_{other.copy_aabb_tree()} {
+    copy_vertices(other);
+  }
 
   Triangle_soup(Triangle_soup&& other) noexcept
       : points_{std::move(other.points_)},
+        coords_{std::move(other.coords_)},
+        states_{std::move(other.states_)},
         faces_{std::move(other.faces_)},
         face_data_{std::move(other.face_data_)},
+        aabb_split_method_{other.aabb_split_method_},
         aabb_tree_{std::move(other.aabb_tree_)} {}
 
   Triangle_soup& operator=(const Triangle_soup& other) {
     if (this != &other) {
-      points_ = other.points_;
+      copy_vertices(other);
       faces_ = other.faces_;
       face_data_ = other.face_data_;
-      aabb_tree_.reset();
+      aabb_split_method_ = other.aabb_split_method_;
+      aabb_tree_ = other.copy_aabb_tree();
     }
     return *this;
   }
 
   Triangle_soup& operator=(Triangle_soup&& other) noexcept {
     points_ = std::move(other.points_);
+    coords_ = std::move(other.coords_);
+    states_ = std::move(other.states_);
     faces_ = std::move(other.faces_);
     face_data_ = std::move(other.face_data_);
+    aabb_split_method_ = other.aabb_split_method_;
     aabb_tree_ = std::move(other.aabb_tree_);
     return *this;
   }
@@ -77,10 +92,29 @@ class Triangle_soup {
       : points_{std::move(points)}, faces_{std::move(faces)}, face_data_{std::move(face_data)} {}
 
   Vertex_index add_vertex(const Point& p) {
+    if (!states_.empty()) {
+      coords_.emplace_back();
+      states_.push_back(kPromoted);
+    }
     points_.push_back(p);
     return Vertex_index{points_.size() - 1};
   }
 
+  // Adds a vertex with double coordinates, such as one read from a file.
+  //
+  // The coordinates are stored as they are, and the point of the kernel, which takes several times
+  // as much memory, is constructed on the first call to point() for the vertex.
+  Vertex_index add_vertex(double x, double y, double z) {
+    if (states_.empty()) {
+      coords_.resize(points_.size());
+      states_.resize(points_.size(), kPromoted);
+    }
+    coords_.push_back({x, y, z});
+    states_.push_back(kDouble);
+    points_.emplace_back();
+    return Vertex_index{points_.size() - 1};
+  }
+
   Face_index add_face(const Face& face) {
     faces_.push_back(face);
     face_data_.emplace_back();
@@ -109,7 +143,23 @@ class Triangle_soup {
 
   const Face& face(Face_index fi) const { return faces_.at(fi.idx()); }
 
-  const Point& point(Vertex_index vi) const { return points_.at(vi.idx()); }
+  // Returns the point of the vertex, which is constructed on the first call if the vertex was
+  // added with double coordinates. This function may be called concurrently.
+  const Point& point(Vertex_index vi) const {
+    if (!states_.empty() && state(vi.idx()).load(std::memory_order_acquire) != kPromoted) {
+      promote(vi.idx());
+    }
+    return points_.at(vi.idx());
+  }
+
+  // Returns the bounding box of the vertex without constructing its point.
+  Bbox vertex_bbox(Vertex_index vi) const {
+    if (!states_.empty() && state(vi.idx()).load(std::memory_order_acquire) != kPromoted) {
+      const auto& [x, y, z] = coords_.at(vi.idx());
+      return {x, y, z, x, y, z};
+    }
+    return points_.at(vi.idx()).approx().bbox();
+  }
 
   Triangle triangle(Face_index fi) const {
     const auto& f = face(fi);
@@ -117,34 +167,147 @@ class Triangle_soup {
   }
 
   Bbox bbox() const {
-    auto bbox_fast = [](const Point& p) -> Bbox { return p.approx().bbox(); };
-
     Bbox bbox;
-    for (const auto& p : points_) {
-      bbox += bbox_fast(p);
+    for (auto vi : vertices()) {
+      bbox += vertex_bbox(vi);
     }
     return bbox;
   }
 
+  // Returns the AABB tree of the faces, which is built on the first call.
+  //
+  // The tree is built without holding the lock, as the build runs nested tasks, and the thread
+  // may run a task that calls this function while waiting for them. Concurrent first calls may
+  // build the tree more than once, in which case only the first one built is kept.
   const AABB_tree<Leaf>& aabb_tree() const {
+    AABB_split_method split_method{};
+    {
+      std::lock_guard lock{aabb_tree_mutex_};
+
+      if (aabb_tree_) {
+        return *aabb_tree_;
+      }
+      split_method = aabb_split_method_;
+    }
+
+    std::vector<Leaf> leaves;
+    leaves.reserve(num_faces());
+    for (auto fi : faces()) {
+      leaves.emplace_back(internal::face_bbox(*this, fi), fi);
+    }
+    auto tree = std::make_unique<AABB_tree<Leaf>>(std::move(leaves), split_method);
+
     std::lock_guard lock{aabb_tree_mutex_};
 
     if (!aabb_tree_) {
-      std::vector<Leaf> leaves;
-      leaves.reserve(num_faces());
-      for (auto fi : faces()) {
-        leaves.emplace_back(internal::face_bbox(*this, fi), fi);
-      }
-      aabb_tree_ = std::make_unique<AABB_tree<Leaf>>(std::move(leaves));
+      aabb_tree_ = std::move(tree);
     }
 
     return *aabb_tree_;
   }
 
+  // Replaces the positions of the vertices while keeping the faces.
+  //
+  // If the AABB tree has been built, it is refitted to the new positions. It is rebuilt on the next
+  // call to aabb_tree() only if refitting has degraded it too much.
+  void set_points(std::vector<Point> points) {
+    if (points.size() != points_.size()) {
+      throw std::invalid_argument("the number of points must not change");
+    }
+
+    points_ = std::move(points);
+    coords_.clear();
+    states_.clear();
+
+    // The tree is refitted without holding the lock for the same reason as in aabb_tree().
+    // No other member function may be called concurrently with this one.
+    if (aabb_tree_) {
+      auto cost_ratio = aabb_tree_->refit(
+          [&](const Leaf& leaf) { return internal::face_bbox(*this, leaf.face_index()); });
+      if (cost_ratio > kMaxRefitCostRatio) {
+        aabb_tree_.reset();
+      }
+    }
+  }
+
+  AABB_split_method aabb_split_method() const { return aabb_split_method_; }
+
+  // Sets the split method of the AABB tree. The tree is rebuilt on the next call to aabb_tree().
+  void set_aabb_split_method(AABB_split_method split_method) {
+    std::lock_guard lock{aabb_tree_mutex_};
+
+    if (split_method != aabb_split_method_) {
+      aabb_split_method_ = split_method;
+      aabb_tree_.reset();
+    }
+  }
+
  private:
-  std::vector<Point> points_;
+  // The maximum ratio of the SAH cost of a refitted AABB tree to that of the built tree.
+  static constexpr double kMaxRefitCostRatio = 2.0;
+
+  std::unique_ptr<AABB_tree<Leaf>> copy_aabb_tree() const {
+    std::lock_guard lock{aabb_tree_mutex_};
+
+    return aabb_tree_ ? std::make_unique<AABB_tree<Leaf>>(*aabb_tree_) : nullptr;
+  }
+
+  // The states of the vertices added with double coordinates.
+  static constexpr std::uint8_t kDouble = 0;
+  static constexpr std::uint8_t kPromoting = 1;
+  static constexpr std::uint8_t kPromoted = 2;
+
+  std::atomic_ref<std::uint8_t> state(std::size_t i) const {
+    return std::atomic_ref<std::uint8_t>{states_.at(i)};
+  }
+
+  // Constructs the point of the vertex from its double coordinates. Among concurrent callers, one
+  // constructs the point and the others wait for it.
+  void promote(std::size_t i) const {
+    auto state = this->state(i);
+    auto expected = kDouble;
+    if (state.compare_exchange_strong(expected, kPromoting, std::memory_order_acquire)) {
+      const auto& [x, y, z] = coords_.at(i);
+      points_.at(i) = Point{x, y, z};
+      state.store(kPromoted, std::memory_order_release);
+      state.notify_all();
+      return;
+    }
+
+    while (expected != kPromoted) {
+      state.wait(expected, std::memory_order_acquire);
+      expected = state.load(std::memory_order_acquire);
+    }
+  }
+
+  // Copies the vertices of the other soup, which may be promoting them concurrently. Only the
+  // points that have been promoted are copied; the other vertices are copied as doubles.
+  void copy_vertices(const Triangle_soup& other) {
+    coords_ = other.coords_;
+    if (other.states_.empty()) {
+      points_ = other.points_;
+      states_.clear();
+      return;
+    }
+
+    points_.assign(other.points_.size(), Point{});
+    states_.assign(other.states_.size(), kDouble);
+    for (std::size_t i = 0; i < points_.size(); ++i) {
+      if (other.state(i).load(std::memory_order_acquire) == kPromoted) {
+        points_.at(i) = other.points_.at(i);
+        states_.at(i) = kPromoted;
+      }
+    }
+  }
+
+  // The points of the vertices. If states_ is not empty, the point of a vertex whose state is not
+  // kPromoted is default-constructed, and its coordinates are in coords_.
+  mutable std::vector<Point> points_;
+  std::vector<std::array<double, 3>> coords_;
+  mutable std::vector<std::uint8_t> states_;
   std::vector<Face> faces_;
   std::vector<Face_data> face_data_;
+  AABB_split_method aabb_split_method_{AABB_split_method::MEDIAN};
   mutable std::unique_ptr<AABB_tree<Leaf>> aabb_tree_;
   mutable std::mutex aabb_tree_mutex_;
 };
@@ -156,14 +319,16 @@ struct Write<Triangle_soup<K, FaceData>> {
     kigumi_write<std::int32_t>(out, t.num_faces());
 
     for (auto vi : t.vertices()) {
-      const auto& p = t.point(vi);
+      // If the bounding box is a point, the coordinates are doubles.
+      auto b = t.vertex_bbox(vi);
 
-      if (p.approx().x().is_point() && p.approx().y().is_point() && p.approx().z().is_point()) {
+      if (b.xmin() == b.xmax() && b.ymin() == b.ymax() && b.zmin() == b.zmax()) {
         kigumi_write<bool>(out, false);
-        kigumi_write<double>(out, p.approx().x().inf());
-        kigumi_write<double>(out, p.approx().y().inf());
-        kigumi_write<double>(out, p.approx().z().inf());
+        kigumi_write<double>(out, b.xmin());
+        kigumi_write<double>(out, b.ymin());
+        kigumi_write<double>(out, b.zmin());
       } else {
+        const auto& p = t.point(vi);
         kigumi_write<bool>(out, true);
         kigumi_write<CGAL::Exact_rational>(out, p.exact().x());
         kigumi_write<CGAL::Exact_rational>(out, p.exact().y());
@@ -201,7 +366,7 @@ struct Read<Triangle_soup<K, FaceData>> {
         kigumi_read<double>(in, x);
         kigumi_read<double>(in, y);
         kigumi_read<double>(in, z);
-        t.add_vertex({x, y, z});
+        t.add_vertex(x, y, z);
       } else {
         CGAL::Exact_rational x;
         CGAL::Exact_rational y;
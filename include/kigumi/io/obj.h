@@ -59,7 +59,7 @@ bool read_obj(std::istream& is, Triangle_soup<K, FaceData>& soup) {
         std::cerr << "invalid vertex line: " << line << std::endl;
         return false;
       }
-      new_soup.add_vertex({x.value, y.value, z.value});
+      new_soup.add_vertex(x.value, y.value, z.value);
     } else if (s == "f") {
       face.clear();
       std::ptrdiff_t v{};
@@ -126,7 +126,7 @@ bool read_off(std::istream& is, Triangle_soup<K, FaceData>& soup) {
           std::cerr << "invalid vertex line: " << line << std::endl;
           return false;
         }
-        new_soup.add_vertex({x.value, y.value, z.value});
+        new_soup.add_vertex(x.value, y.value, z.value);
         --num_vertices;
         if (num_vertices == 0) {
           state = Off_reading_state::READING_FACES;
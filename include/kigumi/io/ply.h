@@ -230,7 +230,7 @@ bool read_ply(std::istream& is, Triangle_soup<K, FaceData>& soup) {
         std::cerr << "invalid vertex line: " << line << std::endl;
         return false;
       }
-      new_soup.add_vertex({x.value, y.value, z.value});
+      new_soup.add_vertex(x.value, y.value, z.value);
     } else if (element_it == face_element_it) {
       face.clear();
       for (auto it = properties.begin(); it != properties.end(); ++it) {
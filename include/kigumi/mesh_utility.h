@@ -19,10 +19,8 @@ namespace internal {
 
 template <class K, class FaceData>
 CGAL::Bbox_3 face_bbox(const Triangle_soup<K, FaceData>& m, Face_index fi) {
-  auto bbox_fast = [](const typename K::Point_3& p) -> CGAL::Bbox_3 { return p.approx().bbox(); };
-
   const auto& f = m.face(fi);
-  return bbox_fast(m.point(f[0])) + bbox_fast(m.point(f[1])) + bbox_fast(m.point(f[2]));
+  return m.vertex_bbox(f[0]) + m.vertex_bbox(f[1]) + m.vertex_bbox(f[2]);
 }
 
 template <class K, class FaceData>
@@ -1,22 +1,119 @@
 #pragma once
 
+#include <kigumi/Thread_pool.h>
 #include <kigumi/threading.h>
 
 #include <algorithm>
 #include <atomic>
 #include <cstddef>
 #include <exception>
-#include <iterator>
 #include <mutex>
-#include <thread>
+#include <utility>
 #include <vector>
 
 namespace kigumi {
 
+namespace internal {
+
+// Splits [0, size) into num_blocks contiguous blocks.
+inline std::pair<std::size_t, std::size_t> block_range(std::size_t size, std::size_t num_blocks,
+                                                       std::size_t block) {
+  return {size * block / num_blocks, size * (block + 1) / num_blocks};
+}
+
+// Hands out the indices [0, size) to threads in chunks.
+//
+// If grain_size is zero, the chunk size is proportional to the number of remaining items
+// (guided scheduling): the first chunks are large so that cheap bodies do not contend
+// on the counter, and the last ones consist of single items to balance the load.
+class Index_chunker {
+ public:
+  Index_chunker(std::size_t size, std::size_t num_threads, std::size_t grain_size)
+      : size_{size}, num_threads_{num_threads}, grain_size_{grain_size} {}
+
+  bool next(std::size_t& begin, std::size_t& end) {
+    auto cur = next_.load(std::memory_order_relaxed);
+    while (cur < size_) {
+      auto remaining = size_ - cur;
+      auto chunk_size = grain_size_ != 0 ? grain_size_ : remaining / (4 * num_threads_);
+      chunk_size = std::clamp(chunk_size, std::size_t{1}, remaining);
+      if (next_.compare_exchange_weak(cur, cur + chunk_size, std::memory_order_relaxed)) {
+        begin = cur;
+        end = cur + chunk_size;
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  std::size_t size_;
+  std::size_t num_threads_;
+  std::size_t grain_size_;
+  alignas(64) std::atomic<std::size_t> next_{};
+};
+
+// Calls body(index, local_state) for the indices [0, size) on num_threads threads,
+// one of which is the calling thread.
+template <class Init, class Body, class Post>
+void run_chunks(std::size_t size, std::size_t num_threads, std::size_t grain_size, Init& init,
+                Body& body, Post& post) {
+  Index_chunker chunker{size, num_threads, grain_size};
+  std::atomic<bool> failed{};
+  std::mutex mutex;
+  std::exception_ptr exception_ptr;
+
+  auto worker = [&] {
+    auto local_state = init();
+
+    try {
+      std::size_t begin{};
+      std::size_t end{};
+      while (chunker.next(begin, end)) {
+        for (auto index = begin; index < end; ++index) {
+          body(index, local_state);
+        }
+
+        if (failed.load(std::memory_order_relaxed)) {
+          return;
+        }
+      }
+
+      std::lock_guard lock{mutex};
+      post(local_state);
+    } catch (...) {
+      std::lock_guard lock{mutex};
+      if (!exception_ptr) {
+        exception_ptr = std::current_exception();
+      }
+      failed = true;
+    }
+  };
+
+  Task_group group;
+  for (std::size_t tid = 1; tid < num_threads; ++tid) {
+    group.run(worker);
+  }
+  worker();
+  group.wait();
+
+  if (exception_ptr) {
+    std::rethrow_exception(exception_ptr);
+  }
+}
+
+}  // namespace internal
+
+// Calls body(item, local_state) for each item in [first, last) in parallel, where local_state is
+// created by init() for each thread and passed to post(local_state) at the end, under a lock.
+//
+// Items are handed out in chunks of grain_size items, or adaptively if grain_size is zero.
+// Pass grain_size = 1 for heavy bodies whose costs differ greatly.
 template <class RandomAccessIterator, class Init, class Body, class Post>
 void parallel_do(RandomAccessIterator first, RandomAccessIterator last, Init init, Body body,
-                 Post post) {
-  auto size = static_cast<std::size_t>(std::distance(first, last));
+                 Post post, std::size_t grain_size = 0) {
+  // Not std::distance, which rejects C++20 iterators such as those of std::views::iota.
+  auto size = static_cast<std::size_t>(last - first);
   if (size == 0) {
     return;
   }
@@ -31,54 +128,102 @@ void parallel_do(RandomAccessIterator first, RandomAccessIterator last, Init ini
     return;
   }
 
-  std::vector<std::thread> threads;
-  std::atomic<std::size_t> next_index{};
-  std::mutex mutex;
-  std::exception_ptr exception_ptr;
-
-  threads.reserve(num_threads);
-  for (std::size_t tid = 0; tid < num_threads; ++tid) {
-    threads.emplace_back([&] {
-      auto local_state = init();
+  auto index_body = [&](std::size_t index, auto& local_state) {
+    body(*(first + index), local_state);
+  };
+  internal::run_chunks(size, num_threads, grain_size, init, index_body, post);
+}
 
-      try {
-        while (true) {
-          auto index = next_index++;
-          if (index >= size) {
-            break;
-          }
+template <class RandomAccessIterator, class Body>
+void parallel_do(RandomAccessIterator first, RandomAccessIterator last, Body body,
+                 std::size_t grain_size = 0) {
+  parallel_do(
+      first, last, [] { return nullptr; }, [&](const auto& item, auto) { body(item); },
+      [](auto) {}, grain_size);
+}
 
-          body(*(first + index), local_state);
+// Same as parallel_do, but uses cost(item), an estimate of the relative cost of body(item, ...),
+// to schedule the work: expensive items are processed first, one at a time, and cheap items
+// are grouped into chunks of similar total cost.
+template <class RandomAccessIterator, class Cost, class Init, class Body, class Post>
+void parallel_do_by_cost(RandomAccessIterator first, RandomAccessIterator last, Cost cost,
+                         Init init, Body body, Post post) {
+  auto size = static_cast<std::size_t>(last - first);
+  if (size == 0) {
+    return;
+  }
 
-          if (exception_ptr) {
-            return;
-          }
-        }
+  auto num_threads = std::min(Threading_context::current().num_threads(), size);
+  if (num_threads == 1) {
+    auto local_state = init();
+    for (auto it = first; it != last; ++it) {
+      body(*it, local_state);
+    }
+    post(local_state);
+    return;
+  }
 
-        std::lock_guard lock{mutex};
-        post(local_state);
-      } catch (...) {
-        std::lock_guard lock{mutex};
-        if (!exception_ptr) {
-          exception_ptr = std::current_exception();
-        }
-      }
-    });
+  std::vector<double> costs;
+  costs.reserve(size);
+  auto total_cost = 0.0;
+  for (auto it = first; it != last; ++it) {
+    auto c = static_cast<double>(cost(*it));
+    costs.push_back(c);
+    total_cost += c;
   }
 
-  for (auto& thread : threads) {
-    thread.join();
+  // The items that cost more than this are processed alone.
+  auto chunk_cost = total_cost / static_cast<double>(16 * num_threads);
+
+  std::vector<std::size_t> order;
+  order.reserve(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    if (costs.at(i) >= chunk_cost) {
+      order.push_back(i);
+    }
   }
+  std::sort(order.begin(), order.end(), [&](auto i, auto j) {
+    return costs.at(i) > costs.at(j) || (costs.at(i) == costs.at(j) && i < j);
+  });
 
-  if (exception_ptr) {
-    std::rethrow_exception(exception_ptr);
+  // chunks[k] = [chunk_ends[k - 1], chunk_ends[k]) in order.
+  std::vector<std::size_t> chunk_ends;
+  chunk_ends.reserve(order.size() + 1);
+  for (std::size_t k = 1; k <= order.size(); ++k) {
+    chunk_ends.push_back(k);
+  }
+  auto accumulated_cost = 0.0;
+  for (std::size_t i = 0; i < size; ++i) {
+    if (costs.at(i) >= chunk_cost) {
+      continue;
+    }
+    order.push_back(i);
+    accumulated_cost += costs.at(i);
+    if (accumulated_cost >= chunk_cost) {
+      chunk_ends.push_back(order.size());
+      accumulated_cost = 0.0;
+    }
   }
+  if (chunk_ends.empty() || chunk_ends.back() != order.size()) {
+    chunk_ends.push_back(order.size());
+  }
+
+  auto chunk_body = [&](std::size_t chunk, auto& local_state) {
+    auto begin = chunk == 0 ? 0 : chunk_ends.at(chunk - 1);
+    auto end = chunk_ends.at(chunk);
+    for (auto k = begin; k < end; ++k) {
+      body(*(first + order.at(k)), local_state);
+    }
+  };
+  num_threads = std::min(num_threads, chunk_ends.size());
+  internal::run_chunks(chunk_ends.size(), num_threads, 1, init, chunk_body, post);
 }
 
-template <class RandomAccessIterator, class Body>
-void parallel_do(RandomAccessIterator first, RandomAccessIterator last, Body body) {
-  parallel_do(
-      first, last, [] { return nullptr; }, [&](const auto& item, auto) { body(item); },
+template <class RandomAccessIterator, class Cost, class Body>
+void parallel_do_by_cost(RandomAccessIterator first, RandomAccessIterator last, Cost cost,
+                         Body body) {
+  parallel_do_by_cost(
+      first, last, cost, [] { return nullptr; }, [&](const auto& item, auto) { body(item); },
       [](auto) {});
 }
 
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <kigumi/parallel_do.h>
+#include <kigumi/threading.h>
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+namespace kigumi {
+
+// Writes the exclusive prefix sums of [first, last), starting from init, to the range beginning
+// at d_first in parallel, and returns the total sum. d_first may be equal to first.
+template <class RandomAccessIterator1, class RandomAccessIterator2, class T>
+T parallel_exclusive_scan(RandomAccessIterator1 first, RandomAccessIterator1 last,
+                          RandomAccessIterator2 d_first, T init) {
+  auto size = static_cast<std::size_t>(std::distance(first, last));
+  auto num_blocks = std::min(Threading_context::current().num_threads(), (size + 4095) / 4096);
+  if (num_blocks <= 1) {
+    for (auto it = first; it != last; ++it, ++d_first) {
+      T value = *it;
+      *d_first = init;
+      init += value;
+    }
+    return init;
+  }
+
+  std::vector<std::size_t> blocks(num_blocks);
+  std::iota(blocks.begin(), blocks.end(), std::size_t{0});
+  std::vector<T> block_sums(num_blocks);
+
+  parallel_do(
+      blocks.begin(), blocks.end(),
+      [&](std::size_t block) {
+        auto [begin, end] = internal::block_range(size, num_blocks, block);
+        T sum{};
+        for (auto i = begin; i < end; ++i) {
+          sum += *(first + i);
+        }
+        block_sums.at(block) = sum;
+      },
+      1);
+
+  for (auto& sum : block_sums) {
+    T value = sum;
+    sum = init;
+    init += value;
+  }
+
+  parallel_do(
+      blocks.begin(), blocks.end(),
+      [&](std::size_t block) {
+        auto [begin, end] = internal::block_range(size, num_blocks, block);
+        auto sum = block_sums.at(block);
+        for (auto i = begin; i < end; ++i) {
+          T value = *(first + i);
+          *(d_first + i) = sum;
+          sum += value;
+        }
+      },
+      1);
+
+  return init;
+}
+
+}  // namespace kigumi
@@ -1,65 +1,296 @@
 #pragma once
 
+#include <kigumi/parallel_do.h>
 #include <kigumi/threading.h>
 
 #include <algorithm>
-#include <barrier>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
 #include <functional>
 #include <iterator>
-#include <thread>
+#include <numeric>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace kigumi {
 
+namespace internal {
+
+// Radix_key<T> maps a value of T to a sequence of num_words unsigned integers
+// whose lexicographical order agrees with std::less<T>. word(t, 0) is the most significant.
+template <class T>
+struct Radix_key;
+
+template <std::unsigned_integral T>
+struct Radix_key<T> {
+  static constexpr std::size_t num_words = 1;
+
+  static std::uint64_t word(const T& t, std::size_t /*i*/) { return t; }
+};
+
+// Mesh indices.
+template <class T>
+  requires requires(const T& t) {
+    { t.idx() } -> std::convertible_to<std::size_t>;
+  }
+struct Radix_key<T> {
+  static constexpr std::size_t num_words = 1;
+
+  static std::uint64_t word(const T& t, std::size_t /*i*/) { return t.idx(); }
+};
+
+template <class T1, class T2>
+  requires requires { Radix_key<T1>::num_words + Radix_key<T2>::num_words; }
+struct Radix_key<std::pair<T1, T2>> {
+  static constexpr std::size_t num_words = Radix_key<T1>::num_words + Radix_key<T2>::num_words;
+
+  static std::uint64_t word(const std::pair<T1, T2>& t, std::size_t i) {
+    return i < Radix_key<T1>::num_words ? Radix_key<T1>::word(t.first, i)
+                                        : Radix_key<T2>::word(t.second,
+                                                              i - Radix_key<T1>::num_words);
+  }
+};
+
+template <class T>
+concept Radix_sortable = requires { Radix_key<T>::num_words; };
+
+template <class T, class Compare>
+concept Less_than_comparator =
+    std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::less<T>>;
+
+// Turns counts[block][bucket] into the offsets at which each block writes its first element of
+// each bucket, when the elements are ordered by bucket and then by block.
+inline void counts_to_offsets(std::vector<std::vector<std::size_t>>& counts) {
+  std::size_t offset{};
+  auto num_buckets = counts.front().size();
+  for (std::size_t bucket = 0; bucket < num_buckets; ++bucket) {
+    for (auto& block_counts : counts) {
+      auto count = block_counts.at(bucket);
+      block_counts.at(bucket) = offset;
+      offset += count;
+    }
+  }
+}
+
+// A stable parallel LSD radix sort. Only as many digits as needed for the largest key are sorted.
+template <class RandomAccessIterator>
+void parallel_radix_sort(RandomAccessIterator first, RandomAccessIterator last,
+                         std::size_t num_threads) {
+  using Value = typename std::iterator_traits<RandomAccessIterator>::value_type;
+  using Key = Radix_key<Value>;
+  constexpr std::size_t kDigitBits = 8;
+  constexpr std::size_t kNumBuckets = std::size_t{1} << kDigitBits;
+
+  auto size = static_cast<std::size_t>(std::distance(first, last));
+  auto num_blocks = num_threads;
+  std::vector<std::size_t> blocks(num_blocks);
+  std::iota(blocks.begin(), blocks.end(), std::size_t{0});
+
+  std::vector<Value> buffer(size);
+  auto src = first;
+  auto dst = buffer.begin();
+  auto sorted_in_buffer = false;
+
+  std::vector<std::vector<std::size_t>> counts(num_blocks, std::vector<std::size_t>(kNumBuckets));
+  std::vector<std::uint64_t> block_max(num_blocks);
+
+  for (auto word = Key::num_words; word-- > 0;) {
+    parallel_do(
+        blocks.begin(), blocks.end(),
+        [&](std::size_t block) {
+          auto [begin, end] = block_range(size, num_blocks, block);
+          std::uint64_t max{};
+          for (auto i = begin; i < end; ++i) {
+            max = std::max(max, Key::word(*(first + i), word));
+          }
+          block_max.at(block) = max;
+        },
+        1);
+    auto num_bits =
+        static_cast<std::size_t>(std::bit_width(*std::max_element(block_max.begin(),
+                                                                   block_max.end())));
+
+    for (std::size_t shift = 0; shift < num_bits; shift += kDigitBits) {
+      auto digit = [&](const Value& v) -> std::size_t {
+        return (Key::word(v, word) >> shift) & (kNumBuckets - 1);
+      };
+
+      parallel_do(
+          blocks.begin(), blocks.end(),
+          [&](std::size_t block) {
+            auto& block_counts = counts.at(block);
+            std::fill(block_counts.begin(), block_counts.end(), 0);
+            auto [begin, end] = block_range(size, num_blocks, block);
+            for (auto i = begin; i < end; ++i) {
+              ++block_counts.at(digit(*(src + i)));
+            }
+          },
+          1);
+
+      // Skip the digit if all elements share it.
+      auto is_trivial = false;
+      for (std::size_t bucket = 0; bucket < kNumBuckets; ++bucket) {
+        std::size_t total{};
+        for (const auto& block_counts : counts) {
+          total += block_counts.at(bucket);
+        }
+        if (total != 0) {
+          is_trivial = total == size;
+          break;
+        }
+      }
+      if (is_trivial) {
+        continue;
+      }
+
+      counts_to_offsets(counts);
+
+      parallel_do(
+          blocks.begin(), blocks.end(),
+          [&](std::size_t block) {
+            auto& offsets = counts.at(block);
+            auto [begin, end] = block_range(size, num_blocks, block);
+            for (auto i = begin; i < end; ++i) {
+              auto& v = *(src + i);
+              *(dst + offsets.at(digit(v))++) = std::move(v);
+            }
+          },
+          1);
+
+      std::swap(src, dst);
+      sorted_in_buffer = !sorted_in_buffer;
+    }
+
+    // The words of the keys are read from the input range at the next iteration.
+    if (sorted_in_buffer) {
+      parallel_do(
+          blocks.begin(), blocks.end(),
+          [&](std::size_t block) {
+            auto [begin, end] = block_range(size, num_blocks, block);
+            std::move(buffer.begin() + begin, buffer.begin() + end, first + begin);
+          },
+          1);
+      src = first;
+      dst = buffer.begin();
+      sorted_in_buffer = false;
+    }
+  }
+}
+
+// A parallel sample sort: the elements are distributed into buckets delimited by splitters
+// chosen from a sample, and then the buckets are sorted independently.
+template <class RandomAccessIterator, class Compare>
+void parallel_sample_sort(RandomAccessIterator first, RandomAccessIterator last, Compare comp,
+                          std::size_t num_threads) {
+  using Value = typename std::iterator_traits<RandomAccessIterator>::value_type;
+  constexpr std::size_t kOversampling = 32;
+
+  auto size = static_cast<std::size_t>(std::distance(first, last));
+  auto num_blocks = num_threads;
+  // More buckets than threads balance the load when the splitters are not ideal.
+  auto num_buckets = 4 * num_threads;
+  std::vector<std::size_t> blocks(num_blocks);
+  std::iota(blocks.begin(), blocks.end(), std::size_t{0});
+
+  std::vector<Value> splitters;
+  {
+    auto num_samples = num_buckets * kOversampling;
+    std::vector<Value> samples;
+    samples.reserve(num_samples);
+    for (std::size_t i = 0; i < num_samples; ++i) {
+      samples.push_back(*(first + (2 * i + 1) * size / (2 * num_samples)));
+    }
+    std::sort(samples.begin(), samples.end(), comp);
+
+    splitters.reserve(num_buckets - 1);
+    for (std::size_t i = 1; i < num_buckets; ++i) {
+      splitters.push_back(samples.at(i * kOversampling));
+    }
+  }
+
+  std::vector<std::uint32_t> bucket_of(size);
+  std::vector<std::vector<std::size_t>> counts(num_blocks, std::vector<std::size_t>(num_buckets));
+
+  parallel_do(
+      blocks.begin(), blocks.end(),
+      [&](std::size_t block) {
+        auto& block_counts = counts.at(block);
+        auto [begin, end] = block_range(size, num_blocks, block);
+        for (auto i = begin; i < end; ++i) {
+          auto bucket = static_cast<std::uint32_t>(std::distance(
+              splitters.begin(),
+              std::upper_bound(splitters.begin(), splitters.end(), *(first + i), comp)));
+          bucket_of.at(i) = bucket;
+          ++block_counts.at(bucket);
+        }
+      },
+      1);
+
+  std::vector<std::size_t> bucket_ends(num_buckets);
+  for (std::size_t bucket = 0; bucket < num_buckets; ++bucket) {
+    for (const auto& block_counts : counts) {
+      bucket_ends.at(bucket) += block_counts.at(bucket);
+    }
+  }
+  std::partial_sum(bucket_ends.begin(), bucket_ends.end(), bucket_ends.begin());
+
+  counts_to_offsets(counts);
+
+  std::vector<Value> buffer(size);
+  parallel_do(
+      blocks.begin(), blocks.end(),
+      [&](std::size_t block) {
+        auto& offsets = counts.at(block);
+        auto [begin, end] = block_range(size, num_blocks, block);
+        for (auto i = begin; i < end; ++i) {
+          buffer.at(offsets.at(bucket_of.at(i))++) = std::move(*(first + i));
+        }
+      },
+      1);
+
+  std::vector<std::size_t> buckets(num_buckets);
+  std::iota(buckets.begin(), buckets.end(), std::size_t{0});
+  parallel_do_by_cost(
+      buckets.begin(), buckets.end(),
+      [&](std::size_t bucket) {
+        auto begin = bucket == 0 ? 0 : bucket_ends.at(bucket - 1);
+        return bucket_ends.at(bucket) - begin;
+      },
+      [&](std::size_t bucket) {
+        auto begin = bucket == 0 ? 0 : bucket_ends.at(bucket - 1);
+        auto end = bucket_ends.at(bucket);
+        std::sort(buffer.begin() + begin, buffer.begin() + end, comp);
+        std::move(buffer.begin() + begin, buffer.begin() + end, first + begin);
+      });
+}
+
+}  // namespace internal
+
+// Sorts [first, last) in parallel. Uses a radix sort if the values are unsigned integers,
+// mesh indices, or pairs of them, and comp is std::less. Otherwise, uses a sample sort.
 template <class RandomAccessIterator, class Compare>
 void parallel_sort(RandomAccessIterator first, RandomAccessIterator last, Compare comp) {
+  using Value = typename std::iterator_traits<RandomAccessIterator>::value_type;
+
   auto size = static_cast<std::size_t>(std::distance(first, last));
   if (size == 0) {
     return;
   }
 
-  auto num_threads = std::min(Threading_context::current().num_threads(), (size + 1023) / 1024);
+  auto num_threads = std::min(Threading_context::current().num_threads(), (size + 4095) / 4096);
   if (num_threads == 1) {
     std::sort(first, last, comp);
     return;
   }
 
-  std::vector<RandomAccessIterator> partitions;
-  std::vector<std::thread> threads;
-  std::barrier barrier(static_cast<std::ptrdiff_t>(num_threads));
-
-  partitions.reserve(num_threads + 1);
-  auto size_per_thread = size / num_threads;
-  for (std::size_t tid = 0; tid < num_threads; ++tid) {
-    partitions.push_back(first + tid * size_per_thread);
-  }
-  partitions.push_back(last);
-
-  threads.reserve(num_threads);
-  for (std::size_t tid = 0; tid < num_threads; ++tid) {
-    threads.emplace_back([&barrier, &comp, num_threads, &partitions, tid] {
-      {
-        auto first = partitions.at(tid);
-        auto last = partitions.at(tid + 1);
-        std::sort(first, last, comp);
-      }
-
-      std::size_t sorted_distance{1};
-      while (sorted_distance < num_threads) {
-        barrier.arrive_and_wait();
-        if (tid % (2 * sorted_distance) == 0) {
-          auto first = partitions.at(tid);
-          auto middle = partitions.at(std::min(tid + sorted_distance, num_threads));
-          auto last = partitions.at(std::min(tid + 2 * sorted_distance, num_threads));
-          std::inplace_merge(first, middle, last, comp);
-        }
-        sorted_distance *= 2;
-      }
-    });
-  }
-
-  for (auto& thread : threads) {
-    thread.join();
+  if constexpr (internal::Radix_sortable<Value> &&
+                internal::Less_than_comparator<Value, Compare>) {
+    internal::parallel_radix_sort(first, last, num_threads);
+  } else {
+    internal::parallel_sample_sort(first, last, comp, num_threads);
   }
 }
 
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <CGAL/enum.h>
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <optional>
+
+namespace kigumi {
+
+namespace internal {
+
+// Predicates evaluated in double precision with static error bounds [Shewchuk 1997], which
+// decide the sign only if it is certified by the bound, and leave the rest to the kernel.
+//
+// They apply to points whose approximations are exact, that is, points whose coordinates are
+// doubles, such as the vertices of input meshes. As the lazy kernel evaluates the predicates in
+// interval arithmetic first, these save its overhead in the common case.
+
+// Sets the coordinates of the point, and returns true if they are doubles.
+template <class Point>
+bool exact_double_coordinates(const Point& p, std::array<double, 3>& coords) {
+  const auto& approx = p.approx();
+  const auto& x = approx.x();
+  const auto& y = approx.y();
+  const auto& z = approx.z();
+  if (!x.is_point() || !y.is_point() || !z.is_point()) {
+    return false;
+  }
+  coords = {x.inf(), y.inf(), z.inf()};
+  return true;
+}
+
+// Returns the same result as CGAL::orientation(p, q, r, s), or std::nullopt if it cannot be
+// certified in double precision.
+template <class Point>
+std::optional<CGAL::Orientation> static_filtered_orientation(const Point& p, const Point& q,
+                                                             const Point& r, const Point& s) {
+  // The relative error bound of the determinant with respect to the permanent.
+  constexpr auto kEpsilon = std::numeric_limits<double>::epsilon() / 2.0;
+  constexpr auto kErrorBound = (7.0 + 56.0 * kEpsilon) * kEpsilon;
+  // Below this, the bound might not cover the errors due to underflow.
+  constexpr auto kMinPermanent = 1e-200;
+
+  std::array<double, 3> pc;
+  std::array<double, 3> qc;
+  std::array<double, 3> rc;
+  std::array<double, 3> sc;
+  if (!exact_double_coordinates(p, pc) || !exact_double_coordinates(q, qc) ||
+      !exact_double_coordinates(r, rc) || !exact_double_coordinates(s, sc)) {
+    return std::nullopt;
+  }
+
+  auto qpx = qc[0] - pc[0];
+  auto qpy = qc[1] - pc[1];
+  auto qpz = qc[2] - pc[2];
+  auto rpx = rc[0] - pc[0];
+  auto rpy = rc[1] - pc[1];
+  auto rpz = rc[2] - pc[2];
+  auto spx = sc[0] - pc[0];
+  auto spy = sc[1] - pc[1];
+  auto spz = sc[2] - pc[2];
+
+  // det = (q - p) . ((r - p) x (s - p)).
+  auto rpy_spz = rpy * spz;
+  auto rpz_spy = rpz * spy;
+  auto rpz_spx = rpz * spx;
+  auto rpx_spz = rpx * spz;
+  auto rpx_spy = rpx * spy;
+  auto rpy_spx = rpy * spx;
+  auto det = qpx * (rpy_spz - rpz_spy) + qpy * (rpz_spx - rpx_spz) + qpz * (rpx_spy - rpy_spx);
+  auto permanent = std::abs(qpx) * (std::abs(rpy_spz) + std::abs(rpz_spy)) +
+                   std::abs(qpy) * (std::abs(rpz_spx) + std::abs(rpx_spz)) +
+                   std::abs(qpz) * (std::abs(rpx_spy) + std::abs(rpy_spx));
+
+  auto bound = kErrorBound * permanent;
+  if (!(permanent >= kMinPermanent)) {
+    // Also rejects NaN due to overflow.
+    return std::nullopt;
+  }
+  if (det > bound) {
+    return CGAL::POSITIVE;
+  }
+  if (det < -bound) {
+    return CGAL::NEGATIVE;
+  }
+  return std::nullopt;
+}
+
+}  // namespace internal
+
+}  // namespace kigumi
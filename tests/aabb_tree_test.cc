@@ -0,0 +1,357 @@
+#include <CGAL/Bbox_3.h>
+#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
+#include <CGAL/Interval_nt.h>
+#include <gtest/gtest.h>
+#include <kigumi/AABB_tree/AABB_leaf.h>
+#include <kigumi/AABB_tree/AABB_ray.h>
+#include <kigumi/AABB_tree/AABB_tree.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+using Bbox = CGAL::Bbox_3;
+using kigumi::AABB_split_method;
+
+namespace {
+
+class Leaf : public kigumi::AABB_leaf {
+ public:
+  Leaf(const CGAL::Bbox_3& bbox, std::size_t id) : AABB_leaf{bbox}, id_{id} {}
+
+  std::size_t id() const { return id_; }
+
+ private:
+  std::size_t id_;
+};
+
+using AABB_tree = kigumi::AABB_tree<Leaf>;
+
+Bbox random_bbox(std::mt19937_64& gen, double size) {
+  std::uniform_real_distribution<double> dist{0.0, 1.0};
+  auto x = dist(gen);
+  auto y = dist(gen);
+  auto z = dist(gen);
+  return {x, y, z, x + size * dist(gen), y + size * dist(gen), z + size * dist(gen)};
+}
+
+std::vector<Leaf> random_leaves(std::size_t num_leaves, std::uint_fast64_t seed = 1) {
+  std::mt19937_64 gen{seed};
+  std::vector<Leaf> leaves;
+  for (std::size_t i = 0; i < num_leaves; ++i) {
+    leaves.emplace_back(random_bbox(gen, 0.05), i);
+  }
+  return leaves;
+}
+
+std::vector<std::size_t> sorted_ids(const std::vector<const Leaf*>& leaves) {
+  std::vector<std::size_t> ids;
+  for (const auto* leaf : leaves) {
+    ids.push_back(leaf->id());
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+using Id_pair = std::pair<std::size_t, std::size_t>;
+
+std::vector<Id_pair> intersecting_pairs(const AABB_tree& tree, const AABB_tree& other) {
+  std::vector<Id_pair> pairs;
+  tree.for_each_intersecting_leaf_pair(
+      other, [] { return std::vector<Id_pair>{}; },
+      [](const Leaf& leaf, const Leaf& other_leaf, std::vector<Id_pair>& local_pairs) {
+        local_pairs.emplace_back(leaf.id(), other_leaf.id());
+      },
+      [&](const std::vector<Id_pair>& local_pairs) {
+        pairs.insert(pairs.end(), local_pairs.begin(), local_pairs.end());
+      });
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+std::vector<Id_pair> intersecting_pairs(const AABB_tree& tree) {
+  std::vector<Id_pair> pairs;
+  tree.for_each_intersecting_leaf_pair(
+      [] { return std::vector<Id_pair>{}; },
+      [](const Leaf& leaf, const Leaf& other_leaf, std::vector<Id_pair>& local_pairs) {
+        local_pairs.emplace_back(leaf.id(), other_leaf.id());
+      },
+      [&](const std::vector<Id_pair>& local_pairs) {
+        pairs.insert(pairs.end(), local_pairs.begin(), local_pairs.end());
+      });
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+std::vector<Id_pair> brute_force_pairs(const std::vector<Leaf>& leaves,
+                                       const std::vector<Leaf>& other_leaves) {
+  std::vector<Id_pair> pairs;
+  for (const auto& leaf : leaves) {
+    for (const auto& other_leaf : other_leaves) {
+      if (CGAL::do_overlap(leaf.bbox(), other_leaf.bbox())) {
+        pairs.emplace_back(leaf.id(), other_leaf.id());
+      }
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+// Returns the pairs of distinct leaves (i, j) with i < j.
+std::vector<Id_pair> brute_force_pairs(const std::vector<Leaf>& leaves) {
+  std::vector<Id_pair> pairs;
+  for (std::size_t i = 0; i < leaves.size(); ++i) {
+    for (auto j = i + 1; j < leaves.size(); ++j) {
+      if (CGAL::do_overlap(leaves.at(i).bbox(), leaves.at(j).bbox())) {
+        pairs.emplace_back(i, j);
+      }
+    }
+  }
+  return pairs;
+}
+
+// Checks that no leaf is paired with itself, and orders each pair as (i, j) with i < j.
+// A pair reported in both orders is kept twice, so that it fails the comparison.
+std::vector<Id_pair> unordered_pairs(std::vector<Id_pair> pairs) {
+  for (auto& [i, j] : pairs) {
+    EXPECT_NE(i, j);
+    if (i > j) {
+      std::swap(i, j);
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+}  // namespace
+
+TEST(AABBTreeTest, GetIntersectingLeaves) {
+  std::mt19937_64 gen{2};
+
+  for (auto split_method :
+       {AABB_split_method::MEDIAN, AABB_split_method::SAH, AABB_split_method::MORTON}) {
+    for (std::size_t num_leaves : {0, 1, 2, 3, 5, 1000}) {
+      auto leaves = random_leaves(num_leaves);
+      AABB_tree tree{leaves, split_method};
+
+      for (auto i = 0; i < 100; ++i) {
+        auto query = random_bbox(gen, 0.2);
+
+        std::vector<const Leaf*> result;
+        tree.get_intersecting_leaves(std::back_inserter(result), query);
+
+        std::vector<std::size_t> expected;
+        for (const auto& leaf : leaves) {
+          if (CGAL::do_overlap(leaf.bbox(), query)) {
+            expected.push_back(leaf.id());
+          }
+        }
+
+        ASSERT_EQ(sorted_ids(result), expected);
+      }
+    }
+  }
+}
+
+TEST(AABBTreeTest, GetIntersectingLeavesOfRays) {
+  using K = CGAL::Exact_predicates_inexact_constructions_kernel;
+  using Interval = CGAL::Interval_nt<>;
+  using Point = K::Point_3;
+  using Ray = K::Ray_3;
+
+  std::mt19937_64 gen{2};
+  std::uniform_real_distribution<double> dist{-0.5, 1.5};
+
+  for (auto split_method :
+       {AABB_split_method::MEDIAN, AABB_split_method::SAH, AABB_split_method::MORTON}) {
+    for (std::size_t num_leaves : {0, 1, 2, 3, 5, 1000}) {
+      auto leaves = random_leaves(num_leaves);
+      AABB_tree tree{leaves, split_method};
+
+      for (auto i = 0; i < 100; ++i) {
+        Point p{dist(gen), dist(gen), dist(gen)};
+        Point q{dist(gen), dist(gen), dist(gen)};
+        if (i % 4 == 0) {
+          // The direction is zero along two axes.
+          q = Point{p.x(), p.y(), q.z()};
+        }
+        Ray ray{p, q};
+        std::array<Interval, 3> origin{Interval{p.x()}, Interval{p.y()}, Interval{p.z()}};
+        std::array<Interval, 3> direction{Interval{q.x()} - origin.at(0),
+                                          Interval{q.y()} - origin.at(1),
+                                          Interval{q.z()} - origin.at(2)};
+
+        std::vector<const Leaf*> result;
+        tree.get_intersecting_leaves(std::back_inserter(result),
+                                     kigumi::AABB_ray{ray, origin, direction});
+
+        std::vector<std::size_t> expected;
+        for (const auto& leaf : leaves) {
+          if (CGAL::do_intersect(leaf.bbox(), ray)) {
+            expected.push_back(leaf.id());
+          }
+        }
+
+        ASSERT_EQ(sorted_ids(result), expected);
+      }
+    }
+  }
+}
+
+TEST(AABBTreeTest, IdenticalLeaves) {
+  Bbox bbox{0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+  std::vector<Leaf> leaves;
+  for (std::size_t i = 0; i < 100; ++i) {
+    leaves.emplace_back(bbox, i);
+  }
+
+  for (auto split_method :
+       {AABB_split_method::MEDIAN, AABB_split_method::SAH, AABB_split_method::MORTON}) {
+    AABB_tree tree{leaves, split_method};
+
+    std::vector<const Leaf*> result;
+    tree.get_intersecting_leaves(std::back_inserter(result), bbox);
+
+    ASSERT_EQ(result.size(), leaves.size());
+  }
+}
+
+TEST(AABBTreeTest, IntersectingLeafPairs) {
+  for (auto split_method :
+       {AABB_split_method::MEDIAN, AABB_split_method::SAH, AABB_split_method::MORTON}) {
+    for (std::size_t num_leaves : {0, 1, 2, 3, 5, 1000}) {
+      auto leaves = random_leaves(num_leaves);
+      AABB_tree tree{leaves, split_method};
+
+      for (std::size_t num_other_leaves : {0, 1, 2, 3, 5, 1000}) {
+        auto other_leaves = random_leaves(num_other_leaves, 2);
+        AABB_tree other{other_leaves, split_method};
+
+        ASSERT_EQ(intersecting_pairs(tree, other), brute_force_pairs(leaves, other_leaves));
+      }
+    }
+  }
+}
+
+TEST(AABBTreeTest, SelfIntersectingLeafPairs) {
+  for (auto split_method :
+       {AABB_split_method::MEDIAN, AABB_split_method::SAH, AABB_split_method::MORTON}) {
+    for (std::size_t num_leaves : {0, 1, 2, 3, 5, 1000}) {
+      auto leaves = random_leaves(num_leaves);
+      AABB_tree tree{leaves, split_method};
+
+      ASSERT_EQ(unordered_pairs(intersecting_pairs(tree)), brute_force_pairs(leaves));
+    }
+  }
+}
+
+TEST(AABBTreeTest, IdenticalLeafPairs) {
+  Bbox bbox{0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+  std::vector<Leaf> leaves;
+  for (std::size_t i = 0; i < 100; ++i) {
+    leaves.emplace_back(bbox, i);
+  }
+
+  for (auto split_method :
+       {AABB_split_method::MEDIAN, AABB_split_method::SAH, AABB_split_method::MORTON}) {
+    AABB_tree tree{leaves, split_method};
+
+    ASSERT_EQ(intersecting_pairs(tree, tree), brute_force_pairs(leaves, leaves));
+    ASSERT_EQ(unordered_pairs(intersecting_pairs(tree)), brute_force_pairs(leaves));
+  }
+}
+
+TEST(AABBTreeTest, EarlyExit) {
+  auto leaves = random_leaves(1000);
+  AABB_tree tree{leaves};
+  Bbox query{0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+
+  std::vector<const Leaf*> all;
+  tree.get_intersecting_leaves(std::back_inserter(all), query);
+  ASSERT_EQ(all.size(), leaves.size());
+
+  std::vector<const Leaf*> visited;
+  auto completed = tree.for_each_intersecting_leaf(query, [&](const Leaf& leaf) {
+    visited.push_back(&leaf);
+    return visited.size() < 10;
+  });
+
+  ASSERT_FALSE(completed);
+  ASSERT_EQ(visited, std::vector<const Leaf*>(all.begin(), all.begin() + 10));
+}
+
+TEST(AABBTreeTest, ByDistance) {
+  auto leaves = random_leaves(1000);
+  AABB_tree tree{leaves};
+  Bbox query{0.0, 0.0, 0.5, 1.0, 1.0, 1.0};
+  auto lower_bound = [](const Bbox& bbox) { return bbox.xmin(); };
+
+  std::vector<double> distances;
+  tree.for_each_intersecting_leaf_by_distance(query, lower_bound, [&](const Leaf& leaf) {
+    distances.push_back(leaf.bbox().xmin());
+    return std::numeric_limits<double>::infinity();
+  });
+
+  std::vector<double> expected;
+  for (const auto& leaf : leaves) {
+    if (CGAL::do_overlap(leaf.bbox(), query)) {
+      expected.push_back(leaf.bbox().xmin());
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+
+  ASSERT_EQ(distances, expected);
+
+  // Only the nearest leaves are visited if the bound is updated.
+  std::vector<double> nearest;
+  tree.for_each_intersecting_leaf_by_distance(query, lower_bound, [&](const Leaf& leaf) {
+    nearest.push_back(leaf.bbox().xmin());
+    return nearest.front();
+  });
+
+  ASSERT_EQ(nearest, std::vector<double>{expected.front()});
+}
+
+TEST(AABBTreeTest, Refit) {
+  std::mt19937_64 gen{3};
+  auto leaves = random_leaves(1000);
+  AABB_tree tree{leaves};
+
+  // A translation does not degrade the tree.
+  auto translate = [](const Bbox& bbox) {
+    return Bbox{bbox.xmin() + 1.0, bbox.ymin(), bbox.zmin(),
+                bbox.xmax() + 1.0, bbox.ymax(), bbox.zmax()};
+  };
+  auto cost_ratio = tree.refit([&](const Leaf& leaf) { return translate(leaf.bbox()); });
+  ASSERT_NEAR(cost_ratio, 1.0, 1e-6);
+
+  // Random positions do.
+  std::vector<Bbox> bboxes;
+  for (std::size_t i = 0; i < leaves.size(); ++i) {
+    bboxes.push_back(random_bbox(gen, 0.05));
+  }
+  cost_ratio = tree.refit([&](const Leaf& leaf) { return bboxes.at(leaf.id()); });
+  ASSERT_GT(cost_ratio, 2.0);
+
+  for (auto i = 0; i < 100; ++i) {
+    auto query = random_bbox(gen, 0.2);
+
+    std::vector<const Leaf*> result;
+    tree.get_intersecting_leaves(std::back_inserter(result), query);
+
+    std::vector<std::size_t> expected;
+    for (std::size_t id = 0; id < bboxes.size(); ++id) {
+      if (CGAL::do_overlap(bboxes.at(id), query)) {
+        expected.push_back(id);
+      }
+    }
+
+    ASSERT_EQ(sorted_ids(result), expected);
+  }
+}
@@ -2,8 +2,12 @@
 #include <CGAL/enum.h>
 #include <gtest/gtest.h>
 #include <kigumi/Region.h>
+#include <kigumi/parallel_do.h>
 
+#include <cstddef>
+#include <ranges>
 #include <utility>
+#include <vector>
 
 #include "make_cube.h"
 
@@ -53,6 +57,55 @@ TEST(BoundedSideTest, InvertedCube) {
   }
 }
 
+TEST(BoundedSideTest, Batch) {
+  auto m = make_cube<K>({0, 0, 0}, {1, 1, 1}, {});
+
+  std::vector<K::Point_3> points;
+  for (auto x : {-1.0, 0.0, 0.5, 1.0, 2.0}) {
+    for (auto y : {-1.0, 0.0, 0.5, 1.0, 2.0}) {
+      for (auto z : {-1.0, 0.0, 0.5, 1.0, 2.0}) {
+        points.emplace_back(x, y, z);
+      }
+    }
+  }
+
+  auto sides = m.bounded_side(points);
+
+  ASSERT_EQ(sides.size(), points.size());
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    ASSERT_EQ(sides.at(i), m.bounded_side(points.at(i)));
+  }
+
+  ASSERT_EQ(M::empty().bounded_side(points),
+            std::vector<CGAL::Bounded_side>(points.size(), CGAL::ON_UNBOUNDED_SIDE));
+  ASSERT_EQ(M::full().bounded_side(points),
+            std::vector<CGAL::Bounded_side>(points.size(), CGAL::ON_BOUNDED_SIDE));
+}
+
+TEST(BoundedSideTest, ConcurrentFirstQueries) {
+  auto m = make_cube<K>({0, 0, 0}, {1, 1, 1}, {});
+  auto expected = make_cube<K>({0, 0, 0}, {1, 1, 1}, {});
+
+  std::vector<K::Point_3> points;
+  for (auto x : {-1.0, 0.0, 0.5, 1.0, 2.0}) {
+    for (auto y : {-1.0, 0.0, 0.5, 1.0, 2.0}) {
+      for (auto z : {-1.0, 0.0, 0.5, 1.0, 2.0}) {
+        points.emplace_back(x, y, z);
+      }
+    }
+  }
+
+  // The AABB tree of the boundary is built by whichever queries run first.
+  std::vector<CGAL::Bounded_side> sides(points.size());
+  auto indices = std::views::iota(std::size_t{0}, points.size());
+  kigumi::parallel_do(indices.begin(), indices.end(),
+                      [&](std::size_t i) { sides.at(i) = m.bounded_side(points.at(i)); }, 1);
+
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    ASSERT_EQ(sides.at(i), expected.bounded_side(points.at(i)));
+  }
+}
+
 TEST(BoundedSideTest, Empty) {
   auto m = M::empty();
 
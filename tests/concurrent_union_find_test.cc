@@ -0,0 +1,30 @@
+#include <gtest/gtest.h>
+#include <kigumi/Concurrent_union_find.h>
+#include <kigumi/parallel_do.h>
+
+#include <numeric>
+#include <vector>
+
+using kigumi::Concurrent_union_find;
+using kigumi::parallel_do;
+
+TEST(ConcurrentUnionFindTest, Roots) {
+  constexpr std::size_t kSize = 100000;
+  constexpr std::size_t kNumSets = 7;
+
+  std::vector<std::size_t> v(kSize);
+  std::iota(v.begin(), v.end(), std::size_t{0});
+
+  // Unite i with i + kNumSets, from the largest index down, so that the roots change many times.
+  Concurrent_union_find union_find{kSize};
+  parallel_do(v.begin(), v.end(), [&](std::size_t i) {
+    auto j = kSize - 1 - i;
+    if (j >= kNumSets) {
+      union_find.unite(j, j - kNumSets);
+    }
+  });
+
+  for (auto i : v) {
+    ASSERT_EQ(union_find.find(i), i % kNumSets);
+  }
+}
@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 #include <kigumi/Boolean_operator.h>
 #include <kigumi/Boolean_region_builder.h>
+#include <kigumi/Corefine.h>
 #include <kigumi/Region.h>
 
 #include <cmath>
@@ -88,6 +89,22 @@ TEST(FaceDataTest, IntersectingPreferFirst) {
   ASSERT_EQ(area2, 3.0);
 }
 
+TEST(FaceDataTest, IntersectingOrientationCache) {
+  // The faces on the shared planes meet at orientations that are zero, which are looked up in the
+  // cache.
+  auto m1 = make_cube<K, Face_data>({0, 0, 0}, {1, 1, 1}, {1});
+  auto m2 = make_cube<K, Face_data>({0.5, 0, 0}, {1.5, 1, 1}, {2});
+  Boolean_region_builder b{m1, m2};
+  auto m = b(Boolean_operator::UNION);
+  ASSERT_EQ(get_areas(m), std::make_pair(5.0, 3.0));
+  ASSERT_GT(b.num_orientation_cache_misses(), 0U);
+
+  auto m3 = make_cube<K, Face_data>({2, 0, 0}, {3, 1, 1}, {2});
+  Boolean_region_builder b2{m1, m3};
+  ASSERT_EQ(b2.num_orientation_cache_hits(), 0U);
+  ASSERT_EQ(b2.num_orientation_cache_misses(), 0U);
+}
+
 TEST(FaceDataTest, IntersectingPreferSecond) {
   auto m1 = make_cube<K, Face_data>({0, 0, 0}, {1, 1, 1}, {1});
   auto m2 = make_cube<K, Face_data>({0.5, 0, 0}, {1.5, 1, 1}, {2});
@@ -98,6 +115,25 @@ TEST(FaceDataTest, IntersectingPreferSecond) {
   ASSERT_EQ(area2, 5.0);
 }
 
+TEST(FaceDataTest, IntersectingLazy) {
+  auto m1 = make_cube<K, Face_data>({0, 0, 0}, {1, 1, 1}, {1});
+  auto m2 = make_cube<K, Face_data>({0.5, 0.25, 0.25}, {1.5, 1.25, 1.25}, {2});
+  Boolean_region_builder b{m1, m2};
+  auto expected = get_areas(b(Boolean_operator::UNION));
+
+  kigumi::Corefine_options opts;
+  opts.set_lazy_intersection_points(true);
+  kigumi::Corefine_context ctx{opts};
+
+  Boolean_region_builder lazy_b{m1, m2};
+  ASSERT_EQ(get_areas(lazy_b(Boolean_operator::UNION)), expected);
+
+  ASSERT_GT(b.num_intersection_points(), 0U);
+  ASSERT_EQ(b.num_evaluated_intersection_points(), b.num_intersection_points());
+  ASSERT_EQ(lazy_b.num_intersection_points(), b.num_intersection_points());
+  ASSERT_LE(lazy_b.num_evaluated_intersection_points(), lazy_b.num_intersection_points());
+}
+
 TEST(FaceDataTest, NonIntersecting) {
   auto m1 = make_cube<K, Face_data>({0, 0, 0}, {1, 1, 1}, {1});
   auto m2 = make_cube<K, Face_data>({2, 0, 0}, {3, 1, 1}, {2});
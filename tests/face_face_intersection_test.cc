@@ -95,6 +95,42 @@ bool test(Point_list& points, std::array<std::size_t, 3> abc, std::array<std::si
 
 }  // namespace
 
+TEST(FaceFaceIntersectionTest, OrientationCache) {
+  // The coordinates are not doubles, so that the orientations are not decided by the static
+  // filter.
+  auto tenth = [](double x, double y, double z) {
+    return Point{K::FT{x} / 10, K::FT{y} / 10, K::FT{z} / 10};
+  };
+
+  Point_list points;
+  std::array abc{
+      points.insert(tenth(0.0, 0.0, 0.0)),
+      points.insert(tenth(3.0, 0.0, 0.0)),
+      points.insert(tenth(0.0, 3.0, 0.0)),
+  };
+  std::array pqr{
+      points.insert(tenth(1.0, 1.0, -1.0)),
+      points.insert(tenth(4.0, 1.0, -1.0)),
+      points.insert(tenth(1.0, 1.0, 2.0)),
+  };
+
+  Face_face_intersection face_face{points};
+  auto inters = face_face(abc[0], abc[1], abc[2], pqr[0], pqr[1], pqr[2]);
+  auto num_misses = face_face.num_cache_misses();
+  ASSERT_GT(num_misses, 0);
+
+  // The cache persists across calls, and is independent of the order of the vertices.
+  auto num_hits = face_face.num_cache_hits();
+  ASSERT_EQ(face_face(abc[0], abc[1], abc[2], pqr[0], pqr[1], pqr[2]), inters);
+  ASSERT_EQ(face_face.num_cache_misses(), num_misses);
+  ASSERT_GT(face_face.num_cache_hits(), num_hits);
+
+  num_hits = face_face.num_cache_hits();
+  face_face(abc[1], abc[2], abc[0], pqr[2], pqr[0], pqr[1]);
+  ASSERT_EQ(face_face.num_cache_misses(), num_misses);
+  ASSERT_GT(face_face.num_cache_hits(), num_hits);
+}
+
 TEST(FaceFaceIntersectionTest, NoIntersectionFast) {
   Point_list points;
   std::array abc{
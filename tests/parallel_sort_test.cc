@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include <kigumi/Mesh_indices.h>
+#include <kigumi/parallel_sort.h>
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+using kigumi::Face_index;
+using kigumi::parallel_sort;
+using kigumi::Vertex_index;
+
+TEST(ParallelSortTest, IndexPairs) {
+  std::mt19937_64 gen{1};
+
+  for (std::size_t size : {0, 1, 1000, 100000, 1000000}) {
+    std::vector<std::pair<Vertex_index, Face_index>> v(size);
+    for (auto& x : v) {
+      x = {Vertex_index{gen() % (size / 3 + 1)}, Face_index{gen() % size}};
+    }
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+
+    parallel_sort(v.begin(), v.end());
+
+    ASSERT_EQ(v, expected);
+  }
+}
+
+TEST(ParallelSortTest, Comparator) {
+  std::mt19937_64 gen{1};
+
+  for (std::size_t size : {0, 1, 1000, 100000, 1000000}) {
+    std::vector<int> v(size);
+    for (auto& x : v) {
+      x = static_cast<int>(gen() % 1000) - 500;
+    }
+    auto expected = v;
+    std::sort(expected.begin(), expected.end(), std::greater{});
+
+    parallel_sort(v.begin(), v.end(), std::greater{});
+
+    ASSERT_EQ(v, expected);
+  }
+}
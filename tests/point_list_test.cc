@@ -0,0 +1,44 @@
+#include <CGAL/Exact_predicates_exact_constructions_kernel.h>
+#include <gtest/gtest.h>
+#include <kigumi/Point_list.h>
+
+#include <random>
+#include <vector>
+
+using K = CGAL::Exact_predicates_exact_constructions_kernel;
+using Point = K::Point_3;
+using Point_list = kigumi::Point_list<K>;
+
+TEST(PointListTest, InsertUnique) {
+  std::mt19937 gen{1};
+  std::uniform_int_distribution<int> dist{0, 20};
+
+  std::vector<Point> points;
+  for (auto i = 0; i < 100000; ++i) {
+    // Some of the points are constructed so that their approximations are not exact.
+    if (i % 10 == 0) {
+      points.push_back(CGAL::midpoint(Point{dist(gen), 0, 0}, Point{dist(gen) / 3.0, 0, 0}));
+    } else {
+      points.emplace_back(dist(gen), dist(gen), dist(gen));
+    }
+  }
+
+  Point_list expected_list;
+  std::vector<std::size_t> expected_ids;
+  expected_list.start_uniqueness_check();
+  for (const auto& p : points) {
+    expected_ids.push_back(expected_list.insert(p));
+  }
+  expected_list.stop_uniqueness_check();
+
+  Point_list list;
+  auto ids = list.insert_unique(points.size(), [&](std::size_t i) -> const Point& {
+    return points.at(i);
+  });
+
+  ASSERT_EQ(ids, expected_ids);
+  ASSERT_EQ(list.size(), expected_list.size());
+  for (std::size_t i = 0; i < list.size(); ++i) {
+    ASSERT_EQ(list.at(i), expected_list.at(i));
+  }
+}
@@ -0,0 +1,41 @@
+#include <CGAL/Exact_predicates_exact_constructions_kernel.h>
+#include <gtest/gtest.h>
+#include <kigumi/static_filters.h>
+
+#include <random>
+
+using K = CGAL::Exact_predicates_exact_constructions_kernel;
+using Point = K::Point_3;
+using kigumi::internal::static_filtered_orientation;
+
+TEST(StaticFiltersTest, Orientation) {
+  std::mt19937 gen{1};
+  std::uniform_int_distribution<int> dist{-1000, 1000};
+  auto random_point = [&] { return Point{dist(gen), dist(gen), dist(gen)}; };
+
+  auto num_decided = 0;
+  for (auto i = 0; i < 10000; ++i) {
+    auto p = random_point();
+    auto q = random_point();
+    auto r = random_point();
+    // Every other s is nearly coplanar with p, q, and r.
+    auto s = i % 2 == 0 ? random_point()
+                        : Point{3 * q.x() + 5 * r.x() - 8 * p.x() + dist(gen) % 2,
+                                3 * q.y() + 5 * r.y() - 8 * p.y() + dist(gen) % 2,
+                                3 * q.z() + 5 * r.z() - 8 * p.z() + dist(gen) % 2};
+
+    auto o = static_filtered_orientation(p, q, r, s);
+    if (o) {
+      ASSERT_EQ(*o, CGAL::orientation(p, q, r, s));
+      ++num_decided;
+    }
+  }
+  ASSERT_GT(num_decided, 5000);
+
+  // Coordinates that are not doubles are left to the kernel.
+  Point p{0, 0, 0};
+  Point q{1, 0, 0};
+  Point r{0, 1, 0};
+  auto s = CGAL::midpoint(Point{0, 0, 1}, Point{0, 0, 1.0 / 3.0});
+  ASSERT_FALSE(static_filtered_orientation(p, q, r, s));
+}
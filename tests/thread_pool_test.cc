@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <kigumi/Task_graph.h>
+#include <kigumi/Thread_pool.h>
+#include <kigumi/parallel_do.h>
+#include <kigumi/threading.h>
+
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+using kigumi::parallel_do;
+using kigumi::Task_graph;
+using kigumi::Task_group;
+using kigumi::Threading_context;
+
+TEST(ThreadPoolTest, ParallelDo) {
+  std::vector<int> v(100000);
+  std::iota(v.begin(), v.end(), 0);
+
+  for (auto i = 0; i < 100; ++i) {
+    std::atomic<long long> sum{};
+    parallel_do(
+        v.begin(), v.end(), [] { return 0LL; }, [](int x, long long& local_sum) { local_sum += x; },
+        [&](long long local_sum) { sum += local_sum; });
+    ASSERT_EQ(sum, 4999950000LL);
+  }
+}
+
+TEST(ThreadPoolTest, NestedTaskGroups) {
+  std::atomic<int> count{};
+
+  Task_group group;
+  for (auto i = 0; i < 16; ++i) {
+    group.run([&] {
+      Task_group inner_group;
+      for (auto j = 0; j < 16; ++j) {
+        inner_group.run([&] { ++count; });
+      }
+      inner_group.wait();
+    });
+  }
+  group.wait();
+
+  ASSERT_EQ(count, 256);
+}
+
+TEST(ThreadPoolTest, Exception) {
+  std::vector<int> v(1000);
+
+  ASSERT_THROW(parallel_do(v.begin(), v.end(),
+                           [](int /*x*/) { throw std::runtime_error("error"); }),
+               std::runtime_error);
+}
+
+TEST(ThreadPoolTest, ThreadingContext) {
+  auto threading_opts = Threading_context::current();
+  threading_opts.set_num_threads(2);
+  Threading_context threading_ctx{threading_opts};
+
+  std::atomic<bool> ok{true};
+
+  Task_group group;
+  for (auto i = 0; i < 16; ++i) {
+    group.run([&] {
+      if (Threading_context::current().num_threads() > 2) {
+        ok = false;
+      }
+    });
+  }
+  group.wait();
+
+  ASSERT_TRUE(ok);
+}
+
+TEST(ThreadPoolTest, ParallelDoByCost) {
+  std::vector<int> v(10000);
+  std::iota(v.begin(), v.end(), 0);
+
+  std::vector<std::atomic<int>> counts(v.size());
+  kigumi::parallel_do_by_cost(
+      v.begin(), v.end(), [](int x) { return x % 100 == 0 ? 1000 : 1; },
+      [&](int x) { ++counts.at(static_cast<std::size_t>(x)); });
+
+  for (const auto& count : counts) {
+    ASSERT_EQ(count, 1);
+  }
+}
+
+TEST(ThreadPoolTest, TaskGraph) {
+  for (auto i = 0; i < 100; ++i) {
+    std::atomic<int> a{};
+    std::atomic<int> b{};
+    std::atomic<int> c{};
+
+    Task_graph graph;
+    auto ta = graph.add([&] { a = 1; });
+    auto tb = graph.add([&] { b = 2; });
+    graph.add([&] { c = a + b; }, {ta, tb});
+    graph.run();
+
+    ASSERT_EQ(c, 3);
+  }
+}
+
+TEST(ThreadPoolTest, TaskGraphException) {
+  std::atomic<bool> ran{};
+
+  Task_graph graph;
+  auto t = graph.add([] { throw std::runtime_error("error"); });
+  graph.add([&] { ran = true; }, {t});
+
+  ASSERT_THROW(graph.run(), std::runtime_error);
+  ASSERT_FALSE(ran);
+}
@@ -0,0 +1,38 @@
+#include <CGAL/Exact_predicates_exact_constructions_kernel.h>
+#include <gtest/gtest.h>
+#include <kigumi/Mesh_indices.h>
+#include <kigumi/Triangle_soup.h>
+
+using K = CGAL::Exact_predicates_exact_constructions_kernel;
+using Point = K::Point_3;
+using Triangle_soup = kigumi::Triangle_soup<K>;
+using kigumi::Vertex_index;
+
+TEST(TriangleSoupTest, DoubleVertices) {
+  Triangle_soup soup;
+  auto vi1 = soup.add_vertex(0.0, 0.0, 0.0);
+  auto vi2 = soup.add_vertex(1.0, 0.0, 0.0);
+  auto vi3 = soup.add_vertex(Point{0, 1, 0});
+  auto vi4 = soup.add_vertex(0.0, 0.0, 1.0);
+  soup.add_face({vi1, vi2, vi3});
+  soup.add_face({vi1, vi3, vi4});
+
+  ASSERT_EQ(soup.num_vertices(), 4U);
+  ASSERT_EQ(vi4, Vertex_index{3});
+
+  // The bounding boxes do not require the points.
+  ASSERT_EQ(soup.vertex_bbox(vi2), CGAL::Bbox_3(1, 0, 0, 1, 0, 0));
+  ASSERT_EQ(soup.bbox(), CGAL::Bbox_3(0, 0, 0, 1, 1, 1));
+
+  ASSERT_EQ(soup.point(vi1), Point(0, 0, 0));
+
+  // The copy has its own points.
+  auto copy = soup;
+
+  ASSERT_EQ(soup.point(vi2), Point(1, 0, 0));
+  ASSERT_EQ(soup.point(vi3), Point(0, 1, 0));
+  ASSERT_EQ(soup.point(vi4), Point(0, 0, 1));
+  ASSERT_EQ(copy.point(vi1), Point(0, 0, 0));
+  ASSERT_EQ(copy.point(vi4), Point(0, 0, 1));
+  ASSERT_EQ(copy.num_vertices(), 4U);
+}